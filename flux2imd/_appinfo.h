@@ -1,4 +1,15 @@
 #pragma once
+// the tools built from the flux2imd sources each identify themselves
+#if defined(TOOL_FLUXGEN)
+#define APP_NAME        "fluxgen"
+#define APP_DESCRIPTION "Generate synthetic flux files with known sector contents"
+#elif defined(TOOL_TRCDUMP)
+#define APP_NAME        "trcdump"
+#define APP_DESCRIPTION "Show flux2imd binary trace files"
+#elif defined(TOOL_FLUX2TRACK)
+#define APP_NAME        "flux2track"
+#define APP_DESCRIPTION "Show the sectors decoded from each track of flux files"
+#else
 #define APP_NAME        "flux2imd"
 #define APP_DESCRIPTION "Convert flux raw/zip files to img format"
-
+#endif
@@ -0,0 +1,372 @@
+/****************************************************************************
+ *  program: flux2imd - create imd image file from kryoflux file            *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+    batch support
+    inputs can be archives, directories holding .zip / .scp / .flx archives or @manifest files listing
+    them, one per line. As the decoder keeps its state in globals, concurrent decodes are run
+    as separate flux2imd processes, each given the original options, the archive name and
+    -z=file which tells it to write its summary to file, for the table shown at the end.
+    With -j=file the workers' .json files are merged into file once they have all finished
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#ifdef _MSC_VER
+#include <io.h>
+#include <process.h>
+#include <windows.h>
+#else
+#include <limits.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#define _MAX_PATH   PATH_MAX
+#endif
+#include "batch.h"
+#include "stats.h"
+#include "util.h"
+
+#define MAXWORKERS  64
+
+static char **inputs;
+static int cntInputs;
+static int sizeInputs;
+
+static void appendInput(const char *name) {
+    if (cntInputs == sizeInputs) {
+        char **newInputs = (char **)xmalloc((sizeInputs += 64) * sizeof(char *));
+        if (inputs) {
+            memcpy(newInputs, inputs, cntInputs * sizeof(char *));
+            free(inputs);
+        }
+        inputs = newInputs;
+    }
+    inputs[cntInputs++] = strcpy((char *)xmalloc(strlen(name) + 1), name);
+}
+
+static int cmpName(const void *a, const void *b) {
+    return strcmp(*(char **)a, *(char **)b);
+}
+
+static bool hasRaw;
+
+static void addArchive(const char *path) {
+    if (extMatch(path, ".zip") || extMatch(path, ".scp") || extMatch(path, ".flx"))
+        appendInput(path);
+    else if (extMatch(path, ".raw"))
+        hasRaw = true;
+}
+
+// true if there is a .flx file transcoded from the archive, as both would decode to the same disk
+static bool hasFlx(int first, const char *archive) {
+    size_t len = strrchr(archive, '.') - archive;
+    for (int i = first; i < cntInputs; i++)
+        if (inputs[i] && strncmp(inputs[i], archive, len) == 0 && inputs[i][len] == '.' && extMatch(inputs[i], ".flx"))
+            return true;
+    return false;
+}
+
+static void addDir(const char *dir) {
+    int first = cntInputs;
+
+    hasRaw = false;
+    if (!scanDir(dir, addArchive))
+        logFull(D_WARNING, "Couldn't open directory %s\n", dir);
+    for (int i = first; i < cntInputs; i++)             // use the .flx file in place of its archive
+        if (!extMatch(inputs[i], ".flx") && hasFlx(first, inputs[i])) {
+            free(inputs[i]);
+            inputs[i] = NULL;
+        }
+    int cnt = first;
+    for (int i = first; i < cntInputs; i++)
+        if (inputs[i])
+            inputs[cnt++] = inputs[i];
+    cntInputs = cnt;
+    qsort(inputs + first, cntInputs - first, sizeof(char *), cmpName);    // directory order is arbitrary
+    if (hasRaw)                         // the .raw files are decoded together as one disk
+        appendInput(dir);
+}
+
+static void addManifest(const char *manifest) {
+    char line[_MAX_PATH + 2];
+    FILE *fp;
+
+    if (!(fp = fopen(manifest, "rt"))) {
+        logFull(D_WARNING, "Cannot open manifest %s\n", manifest);
+        return;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        char *s = line;
+        while (isspace(*s))
+            s++;
+        char *t = strchr(s, '\0');
+        while (t > s && isspace(t[-1]))
+            *--t = '\0';
+        if (*s && *s != '#')            // skip blank and comment lines
+            addInput(s);
+    }
+    fclose(fp);
+}
+
+void addInput(const char *name) {
+    if (*name == '@')
+        addManifest(name + 1);
+    else if (isDir(name))
+        addDir(name);
+    else
+        appendInput(name);
+}
+
+int inputCnt() {
+    return cntInputs;
+}
+
+const char *getInput(int i) {
+    return i < cntInputs ? inputs[i] : NULL;
+}
+
+static void replaceExt(char *dst, const char *src, const char *ext) {
+    strcpy(dst, src);
+    char *s = strrchr(dst, '.');
+    strcpy(s && !strpbrk(s, "/\\") ? s : strchr(dst, 0), ext);
+}
+
+// true if the .imd, or for formats without one the .log, is newer than the input
+bool isUpToDate(const char *name) {
+    char outFile[_MAX_PATH + 1];
+    struct stat inSt, outSt;
+
+    if (stat(name, &inSt) != 0)
+        return false;
+    if (isDir(name))
+        name = dirDiskName(name);
+    replaceExt(outFile, name, ".imd");
+    if (stat(outFile, &outSt) != 0) {
+        replaceExt(outFile, name, ".log");
+        if (stat(outFile, &outSt) != 0)
+            return false;
+    }
+    return outSt.st_mtime >= inSt.st_mtime;
+}
+
+bool writeSummary(const char *summaryFile, summary_t *summary) {
+    FILE *fp;
+    if (!(fp = fopen(summaryFile, "wt")))
+        return false;
+    fprintf(fp, "%d %d\n", summary->tracks, summary->goodTracks);
+    fclose(fp);
+    return true;
+}
+
+static bool readSummary(const char *summaryFile, summary_t *summary) {
+    FILE *fp;
+    bool ok = false;
+    if ((fp = fopen(summaryFile, "rt"))) {
+        ok = fscanf(fp, "%d %d", &summary->tracks, &summary->goodTracks) == 2;
+        fclose(fp);
+    }
+    remove(summaryFile);
+    return ok;
+}
+
+typedef struct {
+    const char *name;
+    enum { PENDING, SKIPPED, RUNNING, DONE, FAILED } state;
+#ifdef _MSC_VER
+    intptr_t pid;
+#else
+    pid_t pid;
+#endif
+    uint64_t start;
+    uint64_t us;
+    summary_t summary;
+    char summaryFile[_MAX_PATH + 1];
+} job_t;
+
+#ifdef _MSC_VER
+// spawnvp joins the arguments with spaces, so quote any that contain them
+static char *quoteArg(const char *arg) {
+    if (!strpbrk(arg, " \t"))
+        return (char *)arg;
+    char *s = (char *)xmalloc(strlen(arg) + 3);
+    sprintf(s, "\"%s\"", arg);
+    return s;
+}
+#endif
+
+static bool startJob(job_t *job, char **args, int argCnt) {
+    char zOpt[_MAX_PATH + 4];
+
+    replaceExt(job->summaryFile, isDir(job->name) ? dirDiskName(job->name) : job->name, ".sum");
+    sprintf(zOpt, "-z=%s", job->summaryFile);
+    remove(job->summaryFile);
+#ifdef _MSC_VER
+    args[argCnt]     = quoteArg(zOpt);
+    args[argCnt + 1] = quoteArg(job->name);
+    args[argCnt + 2] = NULL;
+    job->pid         = _spawnvp(_P_NOWAIT, args[0], args);
+#else
+    args[argCnt]     = zOpt;
+    args[argCnt + 1] = (char *)job->name;
+    args[argCnt + 2] = NULL;
+    fflush(stdout);
+    if ((job->pid = fork()) == 0) {
+        execvp(args[0], args);
+        fprintf(stderr, "cannot run %s\n", args[0]);
+        _exit(127);
+    }
+#endif
+    if (job->pid == -1) {
+        logFull(D_WARNING, "Cannot start worker for %s\n", job->name);
+        job->state = FAILED;
+        return false;
+    }
+    job->start = usClock();
+    job->state = RUNNING;
+    return true;
+}
+
+// wait for any worker to finish, returns the job index
+static int waitJob(job_t *jobs, int cnt) {
+    int status = -1;
+    int i;
+#ifdef _MSC_VER
+    HANDLE handles[MAXWORKERS];
+    int index[MAXWORKERS];
+    int running = 0;
+
+    for (i = 0; i < cnt; i++)
+        if (jobs[i].state == RUNNING) {
+            index[running]     = i;
+            handles[running++] = (HANDLE)jobs[i].pid;
+        }
+    DWORD result = WaitForMultipleObjects(running, handles, FALSE, INFINITE);
+    if (result >= WAIT_OBJECT_0 + running)
+        logFull(D_FATAL, "Failed waiting for batch workers\n");
+    i = index[result - WAIT_OBJECT_0];
+    _cwait(&status, jobs[i].pid, _WAIT_CHILD);
+#else
+    pid_t pid;
+    for (;;) {
+        if ((pid = waitpid(-1, &status, 0)) == -1)
+            logFull(D_FATAL, "Failed waiting for batch workers\n");
+        for (i = 0; i < cnt && (jobs[i].state != RUNNING || jobs[i].pid != pid); i++)
+            ;
+        if (i < cnt)
+            break;
+    }
+    status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+    jobs[i].us    = usClock() - jobs[i].start;
+    jobs[i].state = status == 0 && readSummary(jobs[i].summaryFile, &jobs[i].summary) ? DONE : FAILED;
+    return i;
+}
+
+static void showSummary(job_t *jobs, int cnt, uint64_t us) {
+    int tracks = 0, good = 0, done = 0, failed = 0, skipped = 0;
+
+    printf("\n%-40s %6s %6s %6s %9s  %s\n", "Archive", "Tracks", "Good", "Bad", "Time(s)", "Status");
+    for (int i = 0; i < cnt; i++) {
+        job_t *p = &jobs[i];
+        printf("%-40s ", basename(p->name));
+        switch (p->state) {
+        case DONE:
+            printf("%6d %6d %6d %9.2f  ok\n", p->summary.tracks, p->summary.goodTracks,
+                   p->summary.tracks - p->summary.goodTracks, p->us / 1e6);
+            tracks += p->summary.tracks;
+            good += p->summary.goodTracks;
+            done++;
+            break;
+        case SKIPPED:
+            printf("%30s  up to date\n", "");
+            skipped++;
+            break;
+        default:
+            printf("%20s %9.2f  failed\n", "", p->us / 1e6);
+            failed++;
+            break;
+        }
+    }
+    printf("%-40s %6d %6d %6d %9.2f  %d ok, %d failed, %d skipped\n", "Total", tracks, good, tracks - good,
+           us / 1e6, done, failed, skipped);
+}
+
+// merge the .json files of the files decoded, in input order
+static void mergeJson(job_t *jobs, int cnt, const char *jsonFile) {
+    char name[_MAX_PATH + 1];
+
+    for (int i = 0; i < cnt; i++)
+        if (jobs[i].state == DONE) {
+            replaceExt(name, isDir(jobs[i].name) ? dirDiskName(jobs[i].name) : jobs[i].name, ".json");
+            if (!statsMerge(jsonFile, name))
+                logFull(D_WARNING, "No statistics from %s\n", basename(name));
+        }
+    statsMergeClose();
+}
+
+void runBatch(char **argv, int firstInput, int workers, bool update, const char *jsonFile) {
+    int cnt       = inputCnt();
+    job_t *jobs   = (job_t *)xmalloc(cnt * sizeof(job_t));
+    char **args   = (char **)xmalloc((firstInput + 3) * sizeof(char *));
+    uint64_t start = usClock();
+    int running   = 0;
+
+    // workers get the original options, followed by -z=summary file and the archive
+    for (int i = 0; i < firstInput; i++)
+#ifdef _MSC_VER
+        args[i] = quoteArg(argv[i]);
+#else
+        args[i] = argv[i];
+#endif
+    if (workers > MAXWORKERS)
+        workers = MAXWORKERS;
+
+    memset(jobs, 0, cnt * sizeof(job_t));
+    for (int i = 0; i < cnt; i++) {
+        jobs[i].name  = getInput(i);
+        jobs[i].state = update && isUpToDate(jobs[i].name) ? SKIPPED : PENDING;
+    }
+    for (int next = 0; next < cnt || running;) {
+        while (running < workers && next < cnt) {
+            job_t *job = &jobs[next++];
+            if (job->state == PENDING && startJob(job, args, firstInput))
+                running++;
+        }
+        if (running) {
+            int i = waitJob(jobs, cnt);
+            running--;
+            printf("%s %s in %.2fs\n", basename(jobs[i].name), jobs[i].state == DONE ? "completed" : "failed",
+                   jobs[i].us / 1e6);
+        }
+    }
+    if (jsonFile)
+        mergeJson(jobs, cnt, jsonFile);
+    showSummary(jobs, cnt, usClock() - start);
+    free(args);
+    free(jobs);
+}
@@ -0,0 +1,41 @@
+/****************************************************************************
+ *  program: flux2imd - create imd image file from kryoflux file            *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#pragma once
+#include <stdbool.h>
+
+// archive level summary written by a batch worker for the controlling process
+typedef struct {
+    int tracks;
+    int goodTracks;
+} summary_t;
+
+void addInput(const char *name);        // file, directory or @manifest
+int inputCnt();
+const char *getInput(int i);
+bool isUpToDate(const char *name);
+void runBatch(char **argv, int firstInput, int workers, bool update, const char *jsonFile);   // jsonFile may be NULL
+bool writeSummary(const char *summaryFile, summary_t *summary);
@@ -0,0 +1,289 @@
+/****************************************************************************
+ *  program: flux2imd - create imd image file from kryoflux file            *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+    decode cache
+    each decoded track is saved in its own file in the cache directory, named from a hash
+    of the flux stream and a key made of the user format, cylinder, head, the decode options
+    that affect the result and the flux2imd version. On a re-run, tracks with a matching
+    entry are rebuilt from the cache without running the dpll.
+    The key is saved in the entry and checked on load to guard against hash collisions.
+    When the cache exceeds its size limit the least recently used entries are removed,
+    loading an entry updates its modified time
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef _MSC_VER
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#include <limits.h>
+#define _MAX_PATH   PATH_MAX
+#endif
+#include "_version.h"
+#include "cache.h"
+#include "dpll.h"
+#include "formats.h"
+#include "stats.h"
+#include "stdflux.h"
+#include "trackManager.h"
+#include "util.h"
+
+#define CACHEMAGIC      "F2ICACHE"
+#define CACHEVERSION    2
+#define CACHEEXT        ".f2c"
+#define MAXKEY          256
+
+static char const *cacheDir;
+static uint64_t cacheLimit;
+static uint64_t cacheSize;          // estimate of current size, updated as entries are saved
+
+typedef struct {
+    char *path;
+    time_t mtime;
+    uint64_t size;
+} entry_t;
+
+static entry_t *entries;
+static unsigned cntEntries;
+static unsigned sizeEntries;
+
+static void addEntry(const char *path) {
+    struct stat st;
+
+    if (!extMatch(path, CACHEEXT) || stat(path, &st) != 0)
+        return;
+    if (cntEntries == sizeEntries) {
+        entry_t *newEntries = (entry_t *)xmalloc((sizeEntries += 256) * sizeof(entry_t));
+        if (entries) {
+            memcpy(newEntries, entries, cntEntries * sizeof(entry_t));
+            free(entries);
+        }
+        entries = newEntries;
+    }
+    entries[cntEntries].path  = strcpy((char *)xmalloc(strlen(path) + 1), path);
+    entries[cntEntries].mtime = st.st_mtime;
+    entries[cntEntries].size  = st.st_size;
+    cacheSize += st.st_size;
+    cntEntries++;
+}
+
+static void freeEntries() {
+    for (unsigned i = 0; i < cntEntries; i++)
+        free(entries[i].path);
+    cntEntries = 0;
+}
+
+static int cmpAge(const void *a, const void *b) {
+    time_t ta = ((entry_t *)a)->mtime;
+    time_t tb = ((entry_t *)b)->mtime;
+    return ta < tb ? -1 : ta > tb;
+}
+
+// remove the least recently used entries to bring the cache to 90% of its limit
+static void evict() {
+    unsigned removed = 0;
+
+    cacheSize = 0;
+    scanDir(cacheDir, addEntry);
+    qsort(entries, cntEntries, sizeof(entry_t), cmpAge);
+    for (unsigned i = 0; i < cntEntries && cacheSize > cacheLimit / 10 * 9; i++)
+        if (remove(entries[i].path) == 0) {
+            cacheSize -= entries[i].size;
+            removed++;
+        }
+    freeEntries();
+    logFull(ALWAYS, "Cache limit reached, %u entries removed\n", removed);
+}
+
+void cacheOpen(const char *dir, unsigned limitMB) {
+    if (!isDir(dir))
+        logFull(D_FATAL, "Cache directory %s does not exist\n", dir);
+    cacheDir   = dir;
+    cacheLimit = (uint64_t)limitMB << 20;
+    cacheSize  = 0;
+    scanDir(cacheDir, addEntry);
+    freeEntries();
+}
+
+// key of the decode options that can change the decoded track
+static void makeKey(char *key, const char *usrfmt) {
+    snprintf(key, MAXKEY, "%s|%s|%llx|%d/%d|%s|%x", GIT_VERSION, usrfmt ? usrfmt : "",
+             (unsigned long long)formatHash(usrfmt), getCyl(), getHead(), isAutoDpll() ? "auto" : dpllName(),
+             debug & D_NOOPTIMISE);
+}
+
+static void makePath(char *path, uint64_t hash, const char *key) {
+    for (const char *s = key; *s; s++)             // fold the key into the flux hash
+        hash = (hash ^ (uint8_t)*s) * 0x100000001b3;
+    snprintf(path, _MAX_PATH, "%s/%016llx%s", cacheDir, (unsigned long long)hash, CACHEEXT);
+}
+
+static bool readItem(void *buf, size_t size, FILE *fp) {
+    return fread(buf, size, 1, fp) == 1;
+}
+
+static bool readString(char *buf, unsigned maxLen, FILE *fp) {
+    uint32_t len;
+    if (!readItem(&len, sizeof(len), fp) || len >= maxLen || fread(buf, 1, len, fp) != len)
+        return false;
+    buf[len] = '\0';
+    return true;
+}
+
+static void writeString(const char *s, FILE *fp) {
+    uint32_t len = (uint32_t)strlen(s);
+    fwrite(&len, sizeof(len), 1, fp);
+    fwrite(s, 1, len, fp);
+}
+
+static bool readTrack(FILE *fp, const char *key) {
+    char buf[MAXKEY];
+    uint32_t version;
+    int32_t hdr[9];
+    formatInfo_t *fmt;
+
+    if (fread(buf, 1, 8, fp) != 8 || memcmp(buf, CACHEMAGIC, 8) != 0 || !readItem(&version, sizeof(version), fp) ||
+        version != CACHEVERSION || !readString(buf, MAXKEY, fp) || strcmp(buf, key) != 0 ||
+        !readString(buf, MAXKEY, fp) || !(fmt = lookupFormat(buf)) || !readItem(hdr, sizeof(hdr), fp))
+        return false;
+
+    selectFormat(fmt);
+    initTrack(getCyl(), getHead());
+    trackPtr->status       = hdr[0];
+    trackPtr->cylinder     = hdr[1];
+    trackPtr->side         = hdr[2];
+    trackPtr->altCylinder  = hdr[3];
+    trackPtr->altSide      = hdr[4];
+    trackPtr->cntGoodIdam  = hdr[5];
+    trackPtr->cntGoodData  = hdr[6];
+    trackPtr->cntAnyData   = hdr[7];
+    trackPtr->cntCorrected = hdr[8];
+    if (!readItem(trackPtr->slotToSector, fmt->spt, fp))
+        return false;
+    for (int slot = 0; slot < fmt->spt; slot++) {
+        sector_t *p = &trackPtr->sectors[slot];
+        uint32_t sHdr[3];       // status, voteCnt, count of data copies
+        if (!readItem(sHdr, sizeof(sHdr), fp) || !readItem(&p->idam, sizeof(p->idam), fp) ||
+            !readItem(&p->read, sizeof(p->read), fp))
+            return false;
+        p->status  = sHdr[0];
+        p->voteCnt = sHdr[1];
+        sectorDataList_t **tail = &p->sectorDataList;
+        for (uint32_t i = 0; i < sHdr[2]; i++) {
+            uint32_t len;
+            uint8_t hasSuspect;
+            if (!readItem(&len, sizeof(len), fp) || len > 0x10000 || !readItem(&hasSuspect, 1, fp))
+                return false;
+            unsigned extra       = hasSuspect ? (len + 7) / 8 : 0;
+            sectorDataList_t *q = (sectorDataList_t *)diskAlloc(sizeof(sectorDataList_t) + len + extra);
+            q->next              = NULL;
+            q->sectorData.len    = len;
+            q->sectorData.suspect = hasSuspect ? q->sectorData.data + len : NULL;
+            if (fread(q->sectorData.data, 1, len + extra, fp) != len + extra)
+                return false;
+            *tail = q;
+            tail  = &q->next;
+        }
+    }
+    return true;
+}
+
+bool loadCachedTrack(const char *usrfmt) {
+    char key[MAXKEY];
+    char path[_MAX_PATH + 1];
+    FILE *fp;
+
+    if (!cacheDir || getCyl() < 0 || getHead() < 0)
+        return false;
+    makeKey(key, usrfmt);
+    makePath(path, fluxHash(), key);
+    if (!(fp = fopen(path, "rb")))
+        return false;
+    logCylHead(getCyl(), getHead());
+    bool ok = readTrack(fp, key);
+    fclose(fp);
+    if (!ok) {
+        logFull(D_WARNING, "Ignoring invalid cache entry %s\n", basename(path));
+        return false;
+    }
+    utime(path, NULL);              // mark as recently used
+    stats.cacheHits++;
+    logFull(ALWAYS, "Decoded track loaded from cache\n");
+    return true;
+}
+
+void saveCachedTrack(const char *usrfmt) {
+    char key[MAXKEY];
+    char path[_MAX_PATH + 1];
+    FILE *fp;
+
+    if (!cacheDir || !trackPtr)
+        return;
+    makeKey(key, usrfmt);
+    makePath(path, fluxHash(), key);
+    if (!(fp = fopen(path, "wb"))) {
+        logFull(D_WARNING, "Cannot create cache entry %s\n", basename(path));
+        return;
+    }
+    uint32_t version = CACHEVERSION;
+    int32_t hdr[9]   = { trackPtr->status,      trackPtr->cylinder,    trackPtr->side,
+                         trackPtr->altCylinder, trackPtr->altSide,     trackPtr->cntGoodIdam,
+                         trackPtr->cntGoodData, trackPtr->cntAnyData, trackPtr->cntCorrected };
+    fwrite(CACHEMAGIC, 1, 8, fp);
+    fwrite(&version, sizeof(version), 1, fp);
+    writeString(key, fp);
+    writeString(trackPtr->fmt->name, fp);
+    fwrite(hdr, sizeof(hdr), 1, fp);
+    fwrite(trackPtr->slotToSector, 1, trackPtr->fmt->spt, fp);
+    for (int slot = 0; slot < trackPtr->fmt->spt; slot++) {
+        sector_t *p     = &trackPtr->sectors[slot];
+        uint32_t sHdr[3] = { p->status, p->voteCnt, 0 };
+        for (sectorDataList_t *q = p->sectorDataList; q; q = q->next)
+            sHdr[2]++;
+        fwrite(sHdr, sizeof(sHdr), 1, fp);
+        fwrite(&p->idam, sizeof(p->idam), 1, fp);
+        fwrite(&p->read, sizeof(p->read), 1, fp);
+        for (sectorDataList_t *q = p->sectorDataList; q; q = q->next) {
+            uint32_t len       = q->sectorData.len;
+            uint8_t hasSuspect = q->sectorData.suspect != NULL;
+            fwrite(&len, sizeof(len), 1, fp);
+            fwrite(&hasSuspect, 1, 1, fp);
+            fwrite(q->sectorData.data, 1, len + (hasSuspect ? (len + 7) / 8 : 0), fp);
+        }
+    }
+    cacheSize += ftell(fp);
+    if (fclose(fp) != 0) {
+        remove(path);
+        logFull(D_WARNING, "Failed to write cache entry %s\n", basename(path));
+    }
+    if (cacheSize > cacheLimit)
+        evict();
+}
@@ -8,6 +8,17 @@
 #include "zip.h"
 #include "flux.h"
 #include "stdflux.h"
+#include "readahead.h"
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __GNUC__
+#include <limits.h>
+#define _MAX_PATH PATH_MAX
+#endif
 
 #ifdef _MSC_VER
 #define stricmp _stricmp
@@ -15,29 +26,49 @@
 
 typedef struct {
     bool (*open)(const char *fname);
-    bool (*load)();
+    bool (*fetch)(fluxImage_t *image);     // reads the next track, called from the read ahead thread
+    bool (*load)(fluxImage_t *image);      // loads the fetched track into the flux stream
     bool (*close)();
 } IOFunc;
 
 static bool rawOpen(const char *fname);
-static bool rawLoad();
+static bool rawFetch(fluxImage_t *image);
 static bool rawClose();
 static bool zipOpen(const char *fname);
-static bool zipLoad();
+static bool zipFetch(fluxImage_t *image);
+static bool zipLoad(fluxImage_t *image);
 static bool zipClose();
+static bool dirOpen(const char *fname);
+static bool dirFetch(fluxImage_t *image);
+static bool dirLoad(fluxImage_t *image);
+static bool dirClose();
 bool scpOpen(const char *fname);
-bool scpLoad();
+bool scpFetch(fluxImage_t *image);
+bool scpLoad(fluxImage_t *image);
 bool scpClose();
+bool flxOpen(const char *fname);
+bool flxFetch(fluxImage_t *image);
+bool flxLoad(fluxImage_t *image);
+bool flxClose();
 static bool errOpen(const char *fname);
+static bool kryoLoad(fluxImage_t *image);
 static bool updateCylHead(const char *name);
+bool closeFluxFile();
+
 
+static IOFunc io = { NULL, NULL, NULL, NULL };
+static unsigned trackStep = 1;
 
-static IOFunc io = { NULL, NULL, NULL };
+// the number of images for each track still to be loaded, used to order the streamed IMD file
+static uint8_t pending[MAXCYLINDER][2];
+static int pendingUnknown;              // images whose name does not give the track
 
-static const IOFunc rawFuncs = { &rawOpen, &rawLoad, &rawClose };
-static const IOFunc zipFuncs = { &zipOpen, &zipLoad, &zipClose };
-static const IOFunc scpFuncs = { &scpOpen, &scpLoad, &scpClose};
-static const IOFunc errFuncs = { &errOpen, NULL, NULL };
+static const IOFunc rawFuncs = { &rawOpen, &rawFetch, &kryoLoad, &rawClose };
+static const IOFunc zipFuncs = { &zipOpen, &zipFetch, &zipLoad, &zipClose };
+static const IOFunc scpFuncs = { &scpOpen, &scpFetch, &scpLoad, &scpClose};
+static const IOFunc flxFuncs = { &flxOpen, &flxFetch, &flxLoad, &flxClose };
+static const IOFunc dirFuncs = { &dirOpen, &dirFetch, &dirLoad, &dirClose };
+static const IOFunc errFuncs = { &errOpen, NULL, NULL, NULL };
 
 
 
@@ -45,18 +76,24 @@ bool openFluxFile(const char *fname) {
     const char *s;
 
     if (io.close)
-        io.close();
+        closeFluxFile();
     io = errFuncs;
     setLogPrefix(fname, NULL);
     createLogFile(NULL);            // revert to stdout for general errors
+    memset(pending, 0, sizeof(pending));
+    pendingUnknown = 0;
 
-    if ((s = strrchr(fname, '.'))) {
+    if (isDir(fname))
+        io = dirFuncs;
+    else if ((s = strrchr(fname, '.'))) {
         if (stricmp(s, ".raw") == 0)
             io = rawFuncs;
         else if (stricmp(s, ".zip") == 0)
             io = zipFuncs;
         else if (stricmp(s, ".scp") == 0)
             io = scpFuncs;
+        else if (stricmp(s, ".flx") == 0)
+            io = flxFuncs;
         else
             logFull(D_WARNING, "unsupported file type %s\n", s);
     } else
@@ -65,19 +102,68 @@ bool openFluxFile(const char *fname) {
     bool isOk = io.open(fname);
     if (!isOk)
         io = errFuncs;
+    else
+        readAheadStart(io.fetch);
     return isOk;
 }
 
 
+void setTrackStep(unsigned step) {
+    trackStep = step ? step : 1;
+}
+
+bool isSampledCyl(int cylinder) {
+    return cylinder % trackStep == 0;
+}
+
+// track is cylinder * 2 + head, or -1 if not known until the image is loaded
+void expectTrack(int track) {
+    if (track < 0 || track >= MAXCYLINDER * 2)
+        pendingUnknown++;
+    else
+        pending[track / 2][track % 2]++;
+}
+
+static void trackLoaded(int track) {
+    if (track < 0 || track >= MAXCYLINDER * 2) {
+        if (pendingUnknown)
+            pendingUnknown--;
+    } else if (pending[track / 2][track % 2])
+        pending[track / 2][track % 2]--;
+}
+
+bool isTrackPending(int cylinder, int head) {
+    return pendingUnknown || pending[cylinder][head];
+}
+
+// the track a .raw file holds, from its name
+static int rawTrack(const char *name) {
+    int cyl, head;
+    const char *s = strrchr(name, '\0') - 8;
+
+    if (s >= name && sscanf(s, "%2d.%1d.", &cyl, &head) == 2 && cyl >= 0 && head >= 0 && head < 2)
+        return cyl * 2 + head;
+    return -1;
+}
+
 bool loadFluxStream() {
-    if (io.load && io.load()) {
-        getCellWidth();
-        return true;
+    fluxImage_t image;
+
+    while (readAheadNext(&image)) {
+        bool loaded = io.load(&image);
+        if (image.status != IMG_SKIP)
+            trackLoaded(image.track);
+        releaseImage(&image);
+        if (loaded) {
+            getCellWidth();
+            return true;
+        }
     }
     return false;
 }
 
 bool closeFluxFile() {
+    readAheadStop();
     bool result = io.close ? io.close() : true;
     io = errFuncs;
     createLogFile(NULL);
@@ -91,55 +177,96 @@ static bool errOpen(const char *fname) {
     return false;
 }
 
+// load a kryoflux stream, the name gives the cylinder and head
+static bool kryoLoad(fluxImage_t *image) {
+    if (image->status != IMG_OK) {
+        logFull(D_ERROR, "Failed to load\n");
+        return false;
+    }
+    return loadKryoFlux(image->data, (uint32_t)image->size) && updateCylHead(image->name);
+}
+
+// read a whole file, mapping it rather than reading where possible to avoid a copy of the flux data
+static void readFile(fluxImage_t *image, const char *path) {
+    setImageName(image, path);
+    image->status = IMG_ERROR;
+#ifdef _MSC_VER
+    FILE *fp;
+    if ((fp = fopen(path, "rb")) == NULL)
+        return;
+    fseek(fp, 0, SEEK_END);
+    image->size = ftell(fp);
+    rewind(fp);
+    image->data = (uint8_t *)xmalloc(image->size ? image->size : 1);
+    if (fread(image->data, 1, image->size, fp) == image->size)
+        image->status = IMG_OK;
+    fclose(fp);
+#else
+    struct stat st;
+    int fd;
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            image->data   = (uint8_t *)data;
+            image->size   = st.st_size;
+            image->mapped = true;
+            image->status = IMG_OK;
+        }
+    }
+    close(fd);
+#endif
+}
+
 // data variables for raw files
-static FILE *rawfp;
 static bool rawEof = false;
 static const char *rawName;
-static uint32_t rawBufSize = 0;
-static uint8_t *rawBuf;
 
 static bool rawOpen(const char *fname) {
+    FILE *fp;
     rawName = fname;
-    if ((rawfp = fopen(fname, "rb")) == NULL)
+    if ((fp = fopen(fname, "rb")) == NULL)
         logFull(D_WARNING, "Cannot open .raw file\n");
-    else
+    else {
+        fclose(fp);
         createLogFile(fname);
+        expectTrack(rawTrack(fname));
+    }
     rawEof = false;
-    return rawfp != NULL;
+    return fp != NULL;
 }
 
-static bool rawLoad() {
+static bool rawFetch(fluxImage_t *image) {
     if (rawEof)
         return false;
     rawEof = true;                       // only one attempt at loading
-
-    // work out size of file to load
-    fseek(rawfp, 0, SEEK_END);
-    rawBufSize = ftell(rawfp);
-    rewind(rawfp);
-
-    rawBuf = (uint8_t *)xmalloc(rawBufSize);
-    if (fread(rawBuf, rawBufSize, 1, rawfp) != 1) {
-        logFull(D_ERROR, "Failed to load file\n");
-        return false;
-    }
-    return loadKryoFlux(rawBuf, rawBufSize) && updateCylHead(rawName);         // load in the flux data from buffer extracted from zip file
-
+    readFile(image, rawName);
+    image->track = rawTrack(rawName);
+    return true;
 }
 
 static bool rawClose() {
-    fclose(rawfp);
-    free(rawBuf);
     return true;
 }
 
+// load a .raw file as one track of the current disk, used by the watch mode
+bool loadRawTrack(const char *fname) {
+    fluxImage_t image = { IMG_OK, NULL, 0, NULL, 0, false };
+
+    readFile(&image, fname);
+    bool result = kryoLoad(&image);
+    releaseImage(&image);
+    if (result)
+        getCellWidth();
+    return result;
+}
+
 // data variables for zip files
 static struct zip_t *zip;
 static int zipReadCnt = 0;
 static int zipEntriesCnt = 0;
 static const char *zipName;
-static uint32_t zipBufSize = 0;
-static uint8_t *zipBuf;
 
 static bool zipOpen(const char *fname) {
     if ((zip = zip_open(fname, 0, 'r')) == NULL)
@@ -152,45 +279,122 @@ static bool zipOpen(const char *fname) {
         zipName = fname;
         createLogFile(fname);           // we have some content so create a log file for it
         zipReadCnt = 0;
+        for (int i = 0; i < zipEntriesCnt; i++) {   // note the tracks zipFetch will return
+            zip_entry_openbyindex(zip, i);
+            const char *entryName = zip_entry_name(zip);
+            if (!zip_entry_isdir(zip) && extMatch(entryName, ".raw")) {
+                int track = rawTrack(entryName);
+                if (track < 0 || isSampledCyl(track / 2))
+                    expectTrack(track);
+            }
+            zip_entry_close(zip);
+        }
     }
     return zip != 0;
 }
 
-static bool zipLoad() {
+static bool zipFetch(fluxImage_t *image) {
     while (zipReadCnt < zipEntriesCnt) {
-        if (zipBuf) {
-            free(zipBuf);
-            zipBuf = NULL;
-        }
         zip_entry_openbyindex(zip, zipReadCnt++);
         if (zip_entry_isdir(zip))
             continue;
         const char *entryName = zip_entry_name(zip);
-        setLogPrefix(zipName, entryName);
+        int cyl, head;
+        const char *s = strrchr(entryName, '\0') - 8;
         if (!extMatch(entryName, ".raw"))
-            logFull(ALWAYS, "Skipping as non .raw file\n");
+            image->status = IMG_SKIP;
+        else if (s >= entryName && sscanf(s, "%2d.%1d.", &cyl, &head) == 2 && !isSampledCyl(cyl))
+            continue;                   // skip without decompressing
         else {
-            zipBufSize = (uint32_t)zip_entry_size(zip); // breaks if zip files entries > 4G !!!!
-            zipBuf = (uint8_t *)xmalloc(zipBufSize);
-            memset(zipBuf, 0, zipBufSize);
-            if (zip_entry_noallocread(zip, (void *)zipBuf, zipBufSize) < 0)
-                logFull(D_ERROR, "Failed to load\n");
-            else if (loadKryoFlux(zipBuf, zipBufSize))         // load in the flux data from buffer extracted from zip file
-                return updateCylHead(entryName);
+            image->size = (uint32_t)zip_entry_size(zip); // breaks if zip files entries > 4G !!!!
+            image->data = (uint8_t *)xmalloc(image->size);
+            memset(image->data, 0, image->size);
+            image->status = zip_entry_noallocread(zip, (void *)image->data, image->size) < 0 ? IMG_ERROR : IMG_OK;
         }
+        setImageName(image, entryName);
+        image->track = rawTrack(entryName);
+        return true;
     }
     return false;
 }
 
+static bool zipLoad(fluxImage_t *image) {
+    setLogPrefix(zipName, image->name);
+    if (image->status == IMG_SKIP) {
+        logFull(ALWAYS, "Skipping as non .raw file\n");
+        return false;
+    }
+    return kryoLoad(image);         // load in the flux data from buffer extracted from zip file
+}
+
 static bool zipClose() {
     zip_close(zip);
-    free(zipBuf);
+    return true;
+}
+
+// data variables for a directory of raw files, each file is a track of the disk
+static char dirName[_MAX_PATH + 5];    // without any trailing path separator
+static char **dirFiles;
+static int dirFileCnt;
+static int dirSize;
+static int dirReadCnt;
+
+static void addRawFile(const char *path) {
+    if (!extMatch(path, ".raw"))
+        return;
+    if (dirFileCnt == dirSize) {
+        char **newFiles = (char **)xmalloc((dirSize += 64) * sizeof(char *));
+        if (dirFiles) {
+            memcpy(newFiles, dirFiles, dirFileCnt * sizeof(char *));
+            free(dirFiles);
+        }
+        dirFiles = newFiles;
+    }
+    dirFiles[dirFileCnt++] = strcpy((char *)xmalloc(strlen(path) + 1), path);
+}
+
+static int cmpPath(const void *a, const void *b) {
+    return strcmp(*(char **)a, *(char **)b);
+}
+
+static bool dirOpen(const char *fname) {
+    dirFileCnt = dirReadCnt = 0;
+    scanDir(fname, addRawFile);
+    if (dirFileCnt == 0) {
+        logFull(D_WARNING, "No .raw files\n");
+        return false;
+    }
+    qsort(dirFiles, dirFileCnt, sizeof(char *), cmpPath);
+    for (int i = 0; i < dirFileCnt; i++)
+        expectTrack(rawTrack(dirFiles[i]));
+    createLogFile(strcpy(dirName, dirDiskName(fname)));
+    *strrchr(dirName, '.') = '\0';
+    return true;
+}
+
+static bool dirFetch(fluxImage_t *image) {
+    if (dirReadCnt >= dirFileCnt)
+        return false;
+    image->track = rawTrack(dirFiles[dirReadCnt]);
+    readFile(image, dirFiles[dirReadCnt++]);
+    return true;
+}
+
+static bool dirLoad(fluxImage_t *image) {
+    setLogPrefix(dirName, image->name);
+    return kryoLoad(image);
+}
+
+static bool dirClose() {
+    for (int i = 0; i < dirFileCnt; i++)
+        free(dirFiles[i]);
+    dirFileCnt = 0;
     return true;
 }
 
 static bool updateCylHead(const char *name) {
     int cyl, head;
-    char *s = strrchr(name, '\0') - 8;
+    const char *s = strrchr(name, '\0') - 8;
 
     if (s >= name && sscanf(s, "%2d.%1d.", &cyl, &head) == 2)
         setCylHead(cyl, head);
@@ -3,4 +3,8 @@
 
 bool openFluxFile(const char *fname);
 TrackId *loadFluxStream();
-bool closeFluxFile();
\ No newline at end of file
+bool closeFluxFile();
+bool loadRawTrack(const char *fname);
+void setTrackStep(unsigned step);       // only load cylinders that are a multiple of step
+bool isSampledCyl(int cylinder);
+bool isTrackPending(int cylinder, int head);     // the container has more data for the track
@@ -27,7 +27,9 @@
 #include "flux.h"
 #include "flux2imd.h"
 #include "formats.h"
+#include "stats.h"
 #include "stdflux.h"
+#include "trace.h"
 #include "trackManager.h"
 #include "util.h"
 #include <memory.h>
@@ -52,11 +54,13 @@ static bool chkSizeChange(unsigned sSize) {
         for (formatInfo_t *p = curFormat + 1; p->encoding == curFormat->encoding; p++) {
             if (p->sSize == sSize) {
                 logFull(D_DECODER, "Updated format to %s\n", p->name);
-                curFormat = p;
+                selectFormat(p);
                 updateTrackFmt();
                 return sSize != curSSize; // true if sSize is different from trial sSize
             }
         }
+        if (sSize == curSSize)      // last entry of an O_SIZE group already matches
+            return false;
         logFull(D_FATAL, "%s sector size %d not currently supported\n", curFormat->name,
                 128 << sSize);
     }
@@ -82,6 +86,7 @@ static int getData(int marker, uint16_t *buf, int length) {
         buf++;
         length--;
     }
+    stats.crcCalls++;
     if ((isGood = curFormat->crcFunc(buf, length)))
         for (int i = 0; i < length; i++)
             buf[i] &= 0xff; // remove suspect markers
@@ -103,6 +108,74 @@ static uint8_t conflicts[32] = { 0,   64,  32,  255, 16,  255, 48, 255, 8,   72,
                                  52,  255, 12,  76,  44,  255, 28, 255, 60,  255 };
 
 int32_t fromTs               = 0;
+static bool resumeTrack; // true if an alternative dpll is adding to the current track
+static bool probeOnly;   // decode one revolution with the first profile only, see probeTrack
+static int dataAm;       // soft sector data address mark, used to rebuild the crc for voted sectors
+
+#define MAXCRCBUF   (1024 + 16)
+
+// rebuild the buffer getData used for the crc check, by recreating the leading bytes it included
+// returns the number of leading bytes or -1 if not possible
+static int crcBuffer(int slot, uint16_t *buf, uint16_t *data, unsigned len) {
+    int i = 0;
+
+    if (len + 2 > MAXCRCBUF)
+        return -1;
+    switch (curFormat->options) {
+    case O_MTECH: // header bytes are not saved
+        return -1;
+    case O_HP: // address mark not included in crc
+        break;
+    case O_ZDS:
+        buf[i++] = slot + 0x80;
+        buf[i++] = trackPtr->cylinder;
+        break;
+    case O_LSI:
+        buf[i++] = slot;
+        break;
+    case O_NSI:
+        buf[i++] = 0xfb;
+        break;
+    default:
+        buf[i++] = dataAm & 0xff;
+        break;
+    }
+    memcpy(buf + i, data, len * sizeof(data[0]));
+    if (curFormat->options & O_UINV)
+        invert(buf + i, len - 2);
+    return i;
+}
+
+// check the crc of a voted sector
+static bool chkVotedData(int slot, uint16_t *data, unsigned len) {
+    uint16_t buf[MAXCRCBUF];
+    int prefix = crcBuffer(slot, buf, data, len);
+
+    if (prefix < 0)
+        return false;
+    stats.crcCalls++;
+    return curFormat->crcFunc(buf, prefix + len);
+}
+
+// try to correct a sector with a crc error, returns the number of bits corrected
+static int fixSectorData(int slot, uint16_t *data, unsigned len) {
+    uint16_t buf[MAXCRCBUF];
+    int prefix = crcBuffer(slot, buf, data, len);
+    int bits;
+
+    if (prefix < 0 || (bits = crcCorrect(buf, prefix + len, prefix)) == 0)
+        return 0;
+    memcpy(data, buf + prefix, len * sizeof(data[0]));
+    if (curFormat->options & O_UINV)
+        invert(data, len - 2);
+    return bits;
+}
+
+// sync the local sector status with the track after voting
+static void updateSectorStatus(bool *sectorStatus, int cntSlot) {
+    for (int slot = 0; slot < cntSlot; slot++)
+        sectorStatus[slot] = (trackPtr->sectors[slot].status & SS_DATAGOOD) != 0;
+}
 
 static uint16_t hs8Sync(unsigned cylinder, unsigned slot) {
     int matchType;
@@ -156,15 +229,21 @@ static void hs5GetTrack(int cylinder, int side) {
     int cntSlot           = getHsCnt();
     int sectorSize        = 128 << curFormat->sSize;
 
-    initTrack(cylinder, side);
+    if (!resumeTrack)
+        initTrack(cylinder, side);
+    else
+        updateSectorStatus(sectorStatus, cntSlot);
     resetTracker();
 
     for (int profile = 0; !done && retrain(profile); profile++) {
         seekIndex(0);
         fromTs = peekTs();
-        for (int i = 0; (slot = seekIndex(i)) != EODATA; i++) {
+        int rev = -1;
+        for (int i = 0; (slot = seekIndex(i)) != EODATA && !(probeOnly && i > cntSlot); i++) {
             if (slot < 0)
                 continue;
+            if (slot == 0 || rev < 0)
+                rev++;
             fromTs = peekTs();
             if (!sectorStatus[slot] || (profile == 0 && (debug & D_NOOPTIMISE))) {
                 retrain(0);
@@ -173,8 +252,10 @@ static void hs5GetTrack(int cylinder, int side) {
 
                 while ((matchType = matchPattern(40)) == GAP)
                     ;
+                int32_t amTs = peekTs();
                 if (matchType == NSI_SECTOR) {
                     result = getData(0xfb, rawData, sectorSize + 2);
+                    setReadPos(profile, rev, fromTs, amTs);
                     addSectorData(-slot, result, sectorSize + 1, rawData + 1);
                     sectorStatus[slot] |= result;
                 } else if (matchType == MTECH_SECTOR) {
@@ -199,6 +280,7 @@ static void hs5GetTrack(int cylinder, int side) {
                             idam.sectorId = slot;
                             addIdam(-slot, &idam);
                         }
+                        setReadPos(profile, rev, fromTs, amTs);
                         addSectorData(-slot, result, sectorSize + 1, rawData + 12);
                         sectorStatus[slot] |= result;
                     }
@@ -206,8 +288,10 @@ static void hs5GetTrack(int cylinder, int side) {
                     logFull(D_DECODER, "cannot find start of sector %d\n", slot);
             }
         }
+        if (voteSectors(&chkVotedData))
+            updateSectorStatus(sectorStatus, cntSlot);
         done = true;
-        for (int slot = 0; slot < cntSlot; slot++)
+        for (int slot = 0; !probeOnly && slot < cntSlot; slot++)
             if (!sectorStatus[slot]) {
                 done = false;
                 break;
@@ -226,19 +310,26 @@ static void hs5GetTrack(int cylinder, int side) {
 static void hs8GetTrack(int cylinder, int side) {
     (void)side;
     int slot;
-    uint8_t sectorStatus[32] = { 0 };
+    bool sectorStatus[32] = { false };
     unsigned dataPos;
     int matchType;
 
-    bool done = false;
-    initTrack(cylinder, 0);
+    bool done   = false;
+    int cntSlot = getHsCnt();
+
+    if (!resumeTrack)
+        initTrack(cylinder, 0);
+    else
+        updateSectorStatus(sectorStatus, cntSlot);
     resetTracker();
 
-    int cntSlot = getHsCnt();
     for (int profile = 0; !done; profile++) {
-        for (int i = 0; (slot = seekIndex(i)) != EODATA; i++) {
+        int rev = -1;
+        for (int i = 0; (slot = seekIndex(i)) != EODATA && !(probeOnly && i > cntSlot); i++) {
             if (slot < 0)
                 continue;
+            if (slot == 0 || rev < 0)
+                rev++;
             fromTs = peekTs();
             if (sectorStatus[slot] && profile != 0 &&
                 !(debug & D_NOOPTIMISE)) // skip known good sectors unless D_NOOPTIMISE specified
@@ -252,7 +343,8 @@ static void hs8GetTrack(int cylinder, int side) {
             }
 
             if ((matchType = hs8Sync(cylinder, slot))) {
-                dataPos = getByteCnt(fromTs);
+                dataPos      = getByteCnt(fromTs);
+                int32_t amTs = peekTs();
                 if (curFormat->options == O_LSI &&
                     matchType == ZDS_SECTOR) { // LSI & ZDS on same track assume all ZDS
                     DBGLOG(D_DECODER, "@%d:%d ZDS sector after LSI sector, rescan assuming ZDS\n",
@@ -273,12 +365,14 @@ static void hs8GetTrack(int cylinder, int side) {
                         logFull(D_DECODER, "@%d LSI sector %d premature end\n", dataPos, slot);
                         continue;
                     }
+                    setReadPos(profile, rev, fromTs, amTs);
                     addSectorData(-slot, result, 130, rawData + 1);
                 } else {
                     if ((result = getData(((slot + 0x80) << 8) + cylinder, rawData, 138)) < 0) {
                         logFull(D_DECODER, "@%d ZDS sector %d premature end\n", dataPos, slot);
                         continue;
                     }
+                    setReadPos(profile, rev, fromTs, amTs);
                     addSectorData(-slot, result, 136, rawData + 2);
                 }
 
@@ -299,8 +393,10 @@ static void hs8GetTrack(int cylinder, int side) {
         }
         if (done == true) // retrain caused exit
             break;
+        if (voteSectors(&chkVotedData))
+            updateSectorStatus(sectorStatus, cntSlot);
         done = true; // assume all slots done, set to false if not
-        for (int slot = 0; slot < cntSlot; slot++)
+        for (int slot = 0; !probeOnly && slot < cntSlot; slot++)
             if (!sectorStatus[slot]) {
                 done = false;
                 break;
@@ -315,7 +411,6 @@ static void hs8GetTrack(int cylinder, int side) {
         addIdam(-slot, &idam);
     }
     setOnIndex(NULL);
-    finaliseTrack();
 }
 
 static void ssGetTrack(int cylinder, int side, char const *usrfmt) {
@@ -329,18 +424,24 @@ static void ssGetTrack(int cylinder, int side, char const *usrfmt) {
 
     unsigned idamPos = 0;
     unsigned dataPos = 0;
-    bool savedData   = false;
+    int32_t dataTs;
+    bool savedData   = resumeTrack;
 
-    initTrack(cylinder, side);
+    if (!resumeTrack) {
+        initTrack(cylinder, side);
+        dataAm = DATAAM;
+    }
     unsigned sSize = curFormat->sSize;
 
     bool done      = false;
     int itype;
     int profile;
     for (profile = 0; !done; profile++) {
+        int rev = -1;
         for (int i = 0; !done && (itype = seekIndex(i)) != EODATA; i++) {
             if (itype == SODATA)
                 continue;
+            rev++;
 
             fromTs = peekTs();
             if (!retrain(profile)) {
@@ -394,6 +495,7 @@ static void ssGetTrack(int cylinder, int side, char const *usrfmt) {
                         if (chkSizeChange(sSize) &&
                             savedData) { // new size but we already saved data!!
                             DBGLOG(D_DECODER, "@%d restarted with new size\n", idamPos);
+                            stats.restarts++;
                             restart = true;
                             break;
                         }
@@ -411,15 +513,17 @@ static void ssGetTrack(int cylinder, int side, char const *usrfmt) {
                 case M2FM_DATAAM:
                 case HP_DATAAM:
                     dataPos   = getByteCnt(fromTs);
-
+                    dataTs    = peekTs();
                     sectorLen = matchType == TI_DATAAM ? 288 : 128 << sSize;
                     result    = getData(matchType, rawData, sectorLen + 3);
                     if (result >= 0) {
                         if (curFormat->options & O_UINV)
                             invert(rawData + 1, sectorLen);
+                        setReadPos(profile, rev, fromTs, dataTs);
                         addSectorData(dataPos, result, sectorLen + 2,
                                       rawData + 1); // add data after address mark
                         savedData = true;
+                        dataAm    = matchType;
                         DBGLOG(D_DECODER, "@%d-%d data len %d%s\n", dataPos, getByteCnt(fromTs),
                                sectorLen, result == 1 ? "" : " bad crc");
                     } else
@@ -440,11 +544,32 @@ static void ssGetTrack(int cylinder, int side, char const *usrfmt) {
                 i         = 0;
             } else {
                 DBGLOG(D_DECODER, "@%d end of track\n", getByteCnt(fromTs));
-                done = checkTrack(profile);
+                voteSectors(&chkVotedData);
+                done = checkTrack(profile) || probeOnly;
             }
         }
     }
-    finaliseTrack();
+}
+
+// log the sectors an alternative dpll recovered, prevStatus is the status before it ran
+static void logRecovered(unsigned *prevStatus) {
+    bool any = false;
+    for (int i = 0; i < trackPtr->fmt->spt; i++) {
+        if ((trackPtr->sectors[i].status & ~prevStatus[i]) & SS_GOOD) {
+            if (!any)
+                logFull(ALWAYS, "dpll %s recovered Slot(Sector):", dpllName());
+            any = true;
+            logBasic(" %d", i);
+            if (trackPtr->slotToSector[i] != 0xff)
+                logBasic("(%d)", trackPtr->slotToSector[i]);
+            else
+                logBasic("(\?\?)");
+            if (!(prevStatus[i] & SS_DATAGOOD) && (trackPtr->sectors[i].status & SS_DATAGOOD))
+                logBasic("+data");
+        }
+    }
+    if (any)
+        logBasic("\n");
 }
 
 bool flux2Track(char const *usrfmt) {
@@ -456,26 +581,55 @@ bool flux2Track(char const *usrfmt) {
         return false;
     }
     logCylHead(cylinder, head);
+    traceTrack(cylinder, head);
 
     if (!setInitialFormat(getFormat(usrfmt))) {
         logFull(D_ERROR, "Could not determine encoding\n");
         return false;
     }
-    if ((hs = getHsCnt()) > 0) {
+    hs = getHsCnt();
+    if (hs > 0 && hs != 16 && hs != 10 && hs != 32) {
+        logFull(D_ERROR, "Disk has %d Hard Sectors - currently not supported\n", hs);
+        return false;
+    }
+
+    unsigned prevStatus[MAXSECTOR];
+    resetDpll();
+    for (resumeTrack = false;; resumeTrack = true) {
         if (hs == 16 || hs == 10)
             hs5GetTrack(cylinder, head);
         else if (hs == 32)
             hs8GetTrack(cylinder, head);
-        else {
-            logFull(D_ERROR, "Disk has %d Hard Sectors - currently not supported\n", hs);
-            return false;
-        }
-    } else
-        // ssDumpTrack(usrfmt);
-        ssGetTrack(cylinder, head, usrfmt);
+        else
+            // ssDumpTrack(usrfmt);
+            ssGetTrack(cylinder, head, usrfmt);
+        if (resumeTrack)
+            logRecovered(prevStatus);
+        // in auto mode give the other dpll engines a chance on failing tracks
+        if (isTrackGood() || probeOnly || !nextDpll())
+            break;
+        for (int i = 0; i < trackPtr->fmt->spt; i++)
+            prevStatus[i] = trackPtr->sectors[i].status;
+        stats.dpllRetries++;
+        DBGLOG(D_DECODER, "Retrying track with dpll %s\n", dpllName());
+    }
+    resumeTrack = false;
+    if (probeOnly)
+        return true;
+    correctSectors(&fixSectorData);
+    if (hs != 16 && hs != 10)
+        finaliseTrack();
     return true;
 }
 
+// quick decode of the first revolution with the first dpll profile, used to triage disks
+bool probeTrack(char const *usrfmt) {
+    probeOnly = true;
+    bool result = flux2Track(usrfmt);
+    probeOnly = false;
+    return result;
+}
+
 bool noIMD() {
     return curFormat->options & O_NOIMD;
 }
@@ -21,6 +21,7 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <memory.h>
 #include <string.h>
 #include "flux2imd.h"
@@ -34,7 +35,7 @@
 static int charMask = 0xff;
 
 // forward references
-static int rowSuspectCnt(uint16_t *s, int len);
+static int rowSuspectCnt(sectorData_t *p, int offset, int len);
 static char *sectorToString(track_t *pTrack, uint8_t slot);
 
 // only called when there is data for the sector
@@ -43,63 +44,156 @@ static char *sectorToString(track_t *pTrack, uint8_t slot);
 
 static void cleanUpSuspect(sectorDataList_t *pList) {
     sectorDataList_t *qList;
-    uint16_t *p, *q;
+    sectorData_t *p, *q;
     if (!pList)
         return;
     for (; pList->next; pList = pList->next)
         for (qList = pList->next; qList; qList = qList->next) {
-            int len = pList->sectorData.len <= qList->sectorData.len
-                ? pList->sectorData.len : qList->sectorData.len;
-            p = pList->sectorData.rawData;
-            q = qList->sectorData.rawData;
-            for (int i = 0; i < len; i++)
-                if (((p[i] ^ q[i]) & 0xff) == 0)        // data bytes same
-                    p[i] = q[i] = p[i] & q[i];          // makes sure suspect is cleared if one is not set
+            p = &pList->sectorData;
+            q = &qList->sectorData;
+            if (!p->suspect && !q->suspect)
+                continue;
+            unsigned len = p->len <= q->len ? p->len : q->len;
+            for (unsigned i = 0; i < len; i++)
+                if (p->data[i] == q->data[i] && !(isSuspect(p, i) && isSuspect(q, i))) {    // data bytes same
+                    if (p->suspect)                                                             // make sure suspect is cleared if one is not set
+                        p->suspect[i / 8] &= ~(1 << (i % 8));
+                    if (q->suspect)
+                        q->suspect[i / 8] &= ~(1 << (i % 8));
+                }
         }
 }
 
-static void displayDataLine(uint16_t *p, int len) {
-    for (int j = 0; j < len; j++)
-        logBasic("%02X%c ", p[j] & 0xff, (p[j] & SUSPECT) ? '*' : ' ');
+/*
+ * sector dumps are formatted into a buffer and written with a single logBasic call
+ * per sector, rather than one call per byte
+ */
+static char *dumpBuf;
+static size_t dumpSize;
+static size_t dumpLen;
+
+static char asciiMap[256];           // printable character for each byte, after applying charMask
+static const char hexDigits[] = "0123456789ABCDEF";
+
+static void buildAsciiMap() {
+    for (int i = 0; i < 256; i++) {
+        int c       = i & charMask;
+        asciiMap[i] = (' ' <= c && c <= '~') ? (char)c : '.';
+    }
+}
 
-    for (int j = 0; j < 16; j++) {
-        int c = p[j] & charMask;
-        logBasic("%c", (' ' <= c && c <= '~') ? c : '.');
+static char *dumpReserve(size_t len) {
+    if (dumpLen + len + 1 > dumpSize) {
+        size_t newSize = dumpSize ? dumpSize * 2 : 4096;
+        while (dumpLen + len + 1 > newSize)
+            newSize *= 2;
+        char *newBuf = (char *)xmalloc(newSize);
+        if (dumpBuf) {
+            memcpy(newBuf, dumpBuf, dumpLen);
+            free(dumpBuf);
+        }
+        dumpBuf  = newBuf;
+        dumpSize = newSize;
     }
-    logBasic("\n");
+    return dumpBuf + dumpLen;
+}
+
+static void dumpStr(const char *str) {
+    size_t len = strlen(str);
+    memcpy(dumpReserve(len), str, len);
+    dumpLen += len;
+}
+
+static void dumpFlush() {
+    if (dumpLen) {
+        dumpBuf[dumpLen] = '\0';
+        logBasic("%s", dumpBuf);
+        dumpLen = 0;
+    }
+}
+
+#define SUSPECTCH(p, i) (isSuspect(p, i) ? "*" : "")
+
+static void displayDataLine(sectorData_t *p, int offset, int len) {
+    uint8_t *data = p->data + offset;
+    char *s       = dumpReserve(16 * 4 + 16 + 1);
+    for (int j = 0; j < len; j++) {
+        *s++ = hexDigits[data[j] >> 4];
+        *s++ = hexDigits[data[j] & 0xf];
+        *s++ = isSuspect(p, offset + j) ? '*' : ' ';
+        *s++ = ' ';
+    }
+    for (int j = 0; j < 16; j++)
+        *s++ = asciiMap[data[j]];
+    *s++ = '\n';
+    dumpLen = s - dumpBuf;
 }
 
-static void displayExtraLine(uint16_t *p, int len) {       // len: 1 or 2 just CRC, 4 just fwd/bwd len, 8 fwd/bwd/crc & postamble
+static void displayExtraLine(sectorData_t *p, int offset, int len) {       // len: 1 or 2 just CRC, 4 just fwd/bwd len, 8 fwd/bwd/crc & postamble
+    uint8_t *data = p->data + offset;
+    char line[128];
     switch (len) {
     case 1:
-        logBasic("crc %02X%s\n", p[0] & 0xff, (p[0] & SUSPECT) ? "*" : "");
+        sprintf(line, "crc %02X%s\n", data[0], SUSPECTCH(p, offset));
         break;
     case 2: // simple CRC for bad sector
-        logBasic("crc %02X%s %02X%s\n", p[0] & 0xff, (p[0] & SUSPECT) ? "*" : "", p[1] & 0xff, (p[1] & SUSPECT) ? "*" : "");
+        sprintf(line, "crc %02X%s %02X%s\n", data[0], SUSPECTCH(p, offset), data[1], SUSPECTCH(p, offset + 1));
         break;
     case 4:  // simple fwd / back for good ZDS sector
-        logBasic("forward %d%s/%d%s ", p[3] & 0xff, (p[3] & SUSPECT) ? "*" : "", p[2] & 0xff, (p[2] & SUSPECT) ? "*" : "");
-        logBasic("backward %d%s/%d%s\n", p[1] & 0xff, (p[1] & SUSPECT) ? "*" : "", p[0] & 0xff, (p[0] & SUSPECT) ? "*" : "");
+        sprintf(line, "forward %d%s/%d%s backward %d%s/%d%s\n", data[3], SUSPECTCH(p, offset + 3), data[2], SUSPECTCH(p, offset + 2),
+                data[1], SUSPECTCH(p, offset + 1), data[0], SUSPECTCH(p, offset));
         break;
     case 8:
-        logBasic("forward %d%s/%d%s ", p[3] & 0xff, (p[3] & SUSPECT) ? "*" : "", p[2] & 0xff, (p[2] & SUSPECT) ? "*" : "");
-        logBasic("backward %d%s/%d%s ", p[1] & 0xff, (p[1] & SUSPECT) ? "*" : "", p[0] & 0xff, (p[0] & SUSPECT) ? "*" : "");
-        logBasic("crc %02X%s %02X%s ", p[4] & 0xff, (p[4] & SUSPECT) ? "*" : "", p[5] & 0xff, (p[5] & SUSPECT) ? "*" : "");
-        logBasic("postamble %02X%s %02X%s\n", p[6] & 0xff, (p[6] & SUSPECT) ? "*" : "", p[7] & 0xff, (p[7] & SUSPECT) ? "*" : "");
+        sprintf(line, "forward %d%s/%d%s backward %d%s/%d%s crc %02X%s %02X%s postamble %02X%s %02X%s\n",
+                data[3], SUSPECTCH(p, offset + 3), data[2], SUSPECTCH(p, offset + 2),
+                data[1], SUSPECTCH(p, offset + 1), data[0], SUSPECTCH(p, offset),
+                data[4], SUSPECTCH(p, offset + 4), data[5], SUSPECTCH(p, offset + 5),
+                data[6], SUSPECTCH(p, offset + 6), data[7], SUSPECTCH(p, offset + 7));
         break;
+    default:
+        return;
     }
+    dumpStr(line);
+}
+
+// hash of the row's bytes and suspect markers, used to find duplicate rows quickly
+static uint32_t rowHash(sectorData_t *p, int offset, int len) {
+    uint32_t hash = 2166136261u;            // FNV-1a
+    for (int i = offset; i < offset + len; i++)
+        hash = (hash ^ p->data[i] ^ (isSuspect(p, i) ? 0x100 : 0)) * 16777619u;
+    return hash;
+}
+
+// true if the row has the same bytes and suspect markers in both copies
+static bool sameRow(sectorData_t *p, sectorData_t *q, int offset, int len) {
+    if (memcmp(p->data + offset, q->data + offset, len) != 0)
+        return false;
+    for (int i = offset; i < offset + len; i++)
+        if (!isSuspect(p, i) != !isSuspect(q, i))
+            return false;
+    return true;
 }
 
+// the rows already shown for the current line
+typedef struct {
+    uint32_t hash;
+    sectorData_t *data;
+} shownRow_t;
+
+static shownRow_t *shown;
+static unsigned shownSize;
 
 // to minimse the noise in the dump. If there is a row copy without suspect tags
 // choose to display only it any any other non duplicate copys of the row that also have no suspect tags
+// a row is only compared in full with shown rows that have the same hash
 
-static void displayLine(sector_t *pSector, int offset, int len, void (*displayFunc)(uint16_t *, int)) {
+static void displayLine(sector_t *pSector, int offset, int len, void (*displayFunc)(sectorData_t *, int, int)) {
     char *marker = (pSector->status & SS_DATAGOOD) ? NULL : " ";
     bool cleanOnly = false;
+    unsigned shownCnt = 0;
     sectorDataList_t *p;
     // see if we have a line with no suspect bytes
-    for (p = pSector->sectorDataList; p && rowSuspectCnt(&p->sectorData.rawData[offset], len); p = p->next)    // find row with no tags
+    for (p = pSector->sectorDataList; p && rowSuspectCnt(&p->sectorData, offset, len); p = p->next)    // find row with no tags
         ;
     if (p)
         cleanOnly = true;       // got one so only clean bytes for this line
@@ -107,16 +201,27 @@ static void displayLine(sector_t *pSector, int offset, int len, void (*displayFu
         p = pSector->sectorDataList;
 
     for (; p; p = p->next) {        // go through each of the sectors
-        if (cleanOnly && rowSuspectCnt(&p->sectorData.rawData[offset], len))     // if clean only skip bad rows
+        if (cleanOnly && rowSuspectCnt(&p->sectorData, offset, len))     // if clean only skip bad rows
             continue;
+        uint32_t hash = rowHash(&p->sectorData, offset, len);
         bool duplicate = false;                                 // check if a duplicate
-        for (sectorDataList_t *q = pSector->sectorDataList; q != p && !duplicate; q = q->next)
-            if (memcmp(&p->sectorData.rawData[offset], &q->sectorData.rawData[offset], len * sizeof(uint16_t)) == 0)
+        for (unsigned i = 0; i < shownCnt && !duplicate; i++)
+            if (shown[i].hash == hash && sameRow(&p->sectorData, shown[i].data, offset, len))
                 duplicate = true;
         if (!duplicate) {                                       // no its new
+            if (shownCnt == shownSize) {
+                shownRow_t *newShown = (shownRow_t *)xmalloc((shownSize += 16) * sizeof(shownRow_t));
+                if (shown) {
+                    memcpy(newShown, shown, shownCnt * sizeof(shownRow_t));
+                    free(shown);
+                }
+                shown = newShown;
+            }
+            shown[shownCnt].hash   = hash;
+            shown[shownCnt++].data = &p->sectorData;
             if (marker)
-                logBasic(marker);
-            displayFunc(&p->sectorData.rawData[offset], len);
+                dumpStr(marker);
+            displayFunc(&p->sectorData, offset, len);
             marker = "+";                                       // make sure any more have + marker
         }
     }
@@ -144,7 +249,9 @@ static void displaySector(track_t *pTrack, uint8_t slot, unsigned options) {
     if (!isGood)
         cleanUpSuspect(pSector->sectorDataList);
 
-    logBasic("\n%s:%s\n", sectorToString(pTrack, slot), isGood ? "" : " ---- Corrupt Sector ----");
+    dumpStr("\n");
+    dumpStr(sectorToString(pTrack, slot));
+    dumpStr(isGood ? ":\n" : ": ---- Corrupt Sector ----\n");
 
     for (int i = 0; i < size; i += 16)
         displayLine(pSector, i, size - i >= 16 ? 16 : size - i, displayDataLine);
@@ -161,13 +268,15 @@ static void displaySector(track_t *pTrack, uint8_t slot, unsigned options) {
         displayLine(pSector, size, cntExtra, displayExtraLine);
     }
     if (!isGood)
-        logBasic("       ---- End Corrupt Sector ----\n");
+        dumpStr("       ---- End Corrupt Sector ----\n");
+    dumpFlush();
 }
 
-static int rowSuspectCnt(uint16_t *s, int len) {
+static int rowSuspectCnt(sectorData_t *p, int offset, int len) {
     int cnt = 0;
-    for (int i = 0; i < len; i++, s++)
-        cnt += *s >> 8;
+    if (p->suspect)
+        for (int i = offset; i < offset + len; i++)
+            cnt += isSuspect(p, i) ? 1 : 0;
     return cnt;
 }
 
@@ -189,6 +298,7 @@ void displayDefectMap() {
     bool hasSomeSectors[2] = { false };
     int badSector = 0;
     int badIdam = 0;
+    int corrected = 0;
 
     track_t *pTrack;
     // check whether we have any track on a side and whether there are any bad tracks on each side
@@ -196,7 +306,8 @@ void displayDefectMap() {
         for (int cyl = 0; cyl <= maxCylinder; cyl++)
             if (hasTrack(cyl, head)) {
                 hasSomeSectors[head] = true;
-                if (!(pTrack = getTrack(cyl, head)) || pTrack->cntGoodIdam != pTrack->fmt->spt || pTrack->cntGoodData != pTrack->fmt->spt) {
+                if (!(pTrack = getTrack(cyl, head)) || pTrack->cntGoodIdam != pTrack->fmt->spt || pTrack->cntGoodData != pTrack->fmt->spt ||
+                    pTrack->cntCorrected) {
                     badTrack[head] = true;
                     break;
                 }
@@ -209,13 +320,14 @@ void displayDefectMap() {
             logFull(ALWAYS, "Side %d - all data processed successfully\n", head);
         else {
             logBasic("\n");
-            logFull(ALWAYS, "Side %d - defect map - (x) bad sector, (.) bad idam only\n", head);
+            logFull(ALWAYS, "Side %d - defect map - (x) bad sector, (.) bad idam only, (c) crc corrected\n", head);
             int spt = 0;
             for (int cyl = 0; cyl <= maxCylinder; cyl++) {
                 if (hasTrack(cyl, head)) {
                     if (!(pTrack = getTrack(cyl, head)))
                         logBasic("%02d     data unusable\n", cyl, head);
-                    else if (pTrack->cntGoodData != pTrack->fmt->spt || pTrack->cntGoodIdam != pTrack->fmt->spt) {
+                    else if (pTrack->cntGoodData != pTrack->fmt->spt || pTrack->cntGoodIdam != pTrack->fmt->spt ||
+                             pTrack->cntCorrected) {
                         if (spt != pTrack->fmt->spt) {
                             spt = pTrack->fmt->spt;
                             logBasic("   %.*s\n", spt, "0123456789 123456789 123456789 123456789 123456789 1");
@@ -233,6 +345,10 @@ void displayDefectMap() {
                                     defects[i] = '.';
                                 }
                                 fillCh = ' ';
+                            } else if (pTrack->sectors[i].status & SS_CORRECTED) {
+                                corrected++;
+                                defects[i] = 'c';
+                                fillCh = ' ';
                             } else
                                 defects[i] = fillCh;
                         }
@@ -243,6 +359,8 @@ void displayDefectMap() {
             }
             if (badSector || badIdam)
                 logBasic("\n%d bad sectors and %d bad idam\n", badSector, badIdam);
+            if (corrected)
+                logBasic("%d sectors crc corrected\n", corrected);
         }
     }
 }
@@ -273,7 +391,10 @@ void displayTrack(int cylinder, int side, unsigned options) {
     cylinder = pTrack->cylinder;        // just in case they have been mapped
     side = pTrack->side;
 
-    charMask = options & pOpt ? 0x7f : 0xff;
+    if (charMask != (options & pOpt ? 0x7f : 0xff) || !asciiMap[0]) {
+        charMask = options & pOpt ? 0x7f : 0xff;
+        buildAsciiMap();
+    }
     int spt = pTrack->fmt->spt;
 
     if (!(options & gOpt) && pTrack->cntGoodData == spt && pTrack->cntGoodIdam == spt)
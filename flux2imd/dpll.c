@@ -33,6 +33,15 @@
 #include "util.h"
 #include "trackManager.h"
 #include "stdflux.h"
+#include "stats.h"
+#include "trace.h"
+
+static const DpllFunc *engines[] = { &stdDpll, &ctrDpll };
+#define CNTENGINE   (int)(sizeof(engines) / sizeof(engines[0]))
+
+static int dpllIndex;               // current engine
+static int primaryIndex;            // engine selected by the user, or first for auto
+static bool autoDpll;               // try the other engines on failing tracks
 
 static int32_t ctime, etime;       // clock time and end of cell time
 static int32_t nominalCellSize = 1; 
@@ -43,6 +52,7 @@ static int32_t maxCell;            //  bounds on cell width
 static int32_t minCell;
 
 static int32_t cellDelta;
+static uint8_t lastSlot;            // where in the cell the last transition was seen
 
 uint64_t pattern;
 uint16_t bits65_66 = 0;
@@ -128,7 +138,7 @@ static uint8_t phaseAdjust[2][16] = {		// C1/C2, C3
     //  {13, 14, 14, 15, 15, 16, 16, 16, 16, 16, 16, 17, 17, 18, 18, 19}
 };
 
-int getBit() {
+static int stdGetBit() {
     int slot;
     int cstate = 1;			// default is IPC
 
@@ -144,6 +154,7 @@ int getBit() {
         etime += cellSize;
         return 0;
     }
+    lastSlot = slot;
 
     if (slot < 7 || slot > 8) {
         if ((slot <= 6 && !up) || (slot >= 9 && up)) {			// check for up/down switch
@@ -176,6 +187,11 @@ int getBit() {
     return 1;
 }
 
+int getBit() {
+    stats.dpllBits++;
+    return engines[dpllIndex]->getBit();
+}
+
 int32_t getBitCnt(int32_t fromTs) {
     return (peekTs() - fromTs) / nominalCellSize;
 }
@@ -188,7 +204,15 @@ bool retrain(int profile) {
     if (curFormat->encoding > E_M2FM8)
         logFull(D_FATAL, "For %s unknown encoding %d\n", curFormat->name, curFormat->encoding);
     nominalCellSize = curFormat->nominalCellSize;
+    if (!engines[dpllIndex]->retrain(profile))
+        return false;
+    if (traceLevel)
+        traceBlock(profile);
+    stats.profiles[profile < STATPROFILES ? profile : STATPROFILES - 1]++;
+    return true;
+}
 
+static bool stdRetrain(int profile) {
     if (profile >= CNTPROFILE || profile >= (int)strlen(curFormat->profileOrder)) {
         adaptProfile = 0;
         return false;
@@ -214,6 +238,46 @@ bool retrain(int profile) {
     return true;
 }
 
+static void stdState(uint16_t *cell, uint8_t *phase) {
+    *cell  = (uint16_t)cellSize;
+    *phase = lastSlot;
+}
+
+const DpllFunc stdDpll = { "std", &stdGetBit, &stdRetrain, &stdState };
+
+
+void dpllState(uint16_t *cellSize, uint8_t *phase) {
+    engines[dpllIndex]->state(cellSize, phase);
+}
+
+bool selectDpll(const char *name) {
+    autoDpll = stricmp(name, "auto") == 0;
+    for (primaryIndex = 0; !autoDpll && primaryIndex < CNTENGINE; primaryIndex++)
+        if (stricmp(name, engines[primaryIndex]->name) == 0)
+            break;
+    if (primaryIndex == CNTENGINE) {
+        primaryIndex = 0;
+        return false;
+    }
+    dpllIndex = primaryIndex;
+    return true;
+}
+
+bool isAutoDpll() {
+    return autoDpll;
+}
 
+char *dpllName() {
+    return engines[dpllIndex]->name;
+}
 
+bool nextDpll() {
+    if (!autoDpll || dpllIndex + 1 >= CNTENGINE)
+        return false;
+    dpllIndex++;
+    return true;
+}
 
+void resetDpll() {
+    dpllIndex = primaryIndex;
+}
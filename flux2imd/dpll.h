@@ -31,9 +31,27 @@
 extern uint64_t pattern;
 extern uint16_t bits65_66;
 
+// each dpll engine provides its own getBit & retrain
+typedef struct {
+    char *name;
+    int (*getBit)();
+    bool (*retrain)(int profile);
+    void (*state)(uint16_t *cellSize, uint8_t *phase);  // for tracing
+} DpllFunc;
+
+extern const DpllFunc stdDpll;      // dpll.c
+extern const DpllFunc ctrDpll;      // ndpll.c
+
 int getBit();               // get next bit or -1 if end of flux stream
 int32_t getBitCnt(int32_t fromTs);       // support function to return number of bits processed
 int32_t getByteCnt(int32_t fromTs);      // support function to return number of bytes processed
 bool retrain(int profile);  // reset the dpll using specified profile
+void dpllState(uint16_t *cellSize, uint8_t *phase); // current cell width (ns) & phase of last transition (16ths)
+
+bool selectDpll(const char *name);  // std, ctr or auto
+bool isAutoDpll();
+char *dpllName();
+bool nextDpll();            // auto mode only, switch to next engine, false if none left
+void resetDpll();           // revert to the primary engine
 
 
@@ -31,6 +31,7 @@
 #include "flux.h"
 #include "util.h"
 #include "stdflux.h"
+#include "stats.h"
 
 // default smample & index clocks
 #define SCK 24027428.5714285            // sampling clock frequency
@@ -75,7 +76,7 @@ bool pass2KryoFlux(const uint8_t *image, uint32_t size);
 static void addFluxIndex(uint32_t streamPos, uint32_t sampleCnt, uint32_t indexCnt) {
     if (fluxIndexCnt >= MAXROTATE * (MAXHARDSECTOR + 1))
         logFull(D_ERROR, "addFluxIndex: too many indexes\n");
-    printf("%d %d %d\n", streamPos, sampleCnt, indexCnt);
+    DBGLOG(D_FLUX, "index %u %u %u\n", streamPos, sampleCnt, indexCnt);
     fluxIndex[fluxIndexCnt].streamPos = streamPos;
     if (streamPos == 0) {
         logFull(D_WARNING, "Ignoring index before start of data.\n");
@@ -109,9 +110,14 @@ static void finishFluxPass1(uint32_t streamPos, uint32_t sampleCnt) {
     fluxIndex[fluxIndexCnt].sampleCnt = 0;
     fluxIndex[fluxIndexCnt++].itype = EODATA;
 
-    double rpm = calcRPM(1);     // get an initial RPM
+    double rpm = calcRPM(0);     // get an initial RPM, for the data before the first index
 
-    beginFlux(sampleCnt, fluxIndexCnt, sck, rpm < 327.0 ? 300.0 : 360.00, hc);
+    double revRpm[MAXROTATE];    // the nominal speed is chosen using all the revolutions
+    int revCnt = 0;
+    for (int i = 0; revCnt < MAXROTATE && i + hc + 1 < fluxIndexCnt - 1; i += hc + 1)
+        revRpm[revCnt++] = calcRPM(i);
+    beginFlux(sampleCnt, fluxIndexCnt, sck, revCnt ? nominalRPM(revRpm, revCnt) : rpm < 327.0 ? 300.0 : 360.00, hc);
+    setIndexClock(ick);
     setActualRPM(rpm);
 
     if (hc > 0) {
@@ -180,7 +186,7 @@ static uint32_t oob(const uint8_t *fluxBuf, uint32_t fluxPos, uint32_t size, uin
                 }
                 if (matchType == OOB_STREAMEND && num2 != 0)
                     logFull(D_ERROR, "Steam End Block Error Code = %lu\n", num2);
-                printf("Stream: %d %d\n", num1, num2);
+                DBGLOG(D_FLUX, "Stream: %u %u\n", num1, num2);
             }
             break;
         case OOB_INDEX:
@@ -227,6 +233,7 @@ static uint32_t oob(const uint8_t *fluxBuf, uint32_t fluxPos, uint32_t size, uin
     2) build the standard flux format
 */
 bool loadKryoFlux(const uint8_t *image, uint32_t size) {
+    stats.bytes += size;
     if (pass1KryoFlux(image, size) && pass2KryoFlux(image, size))
         return true;
 
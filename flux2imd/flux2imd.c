@@ -43,9 +43,25 @@
 #include "container.h"
 #include "stdflux.h"
 #include "utility.h"
+#include "dpll.h"
+#include "flx.h"
+#include "batch.h"
+#include "cache.h"
+#include "probe.h"
+#include "readahead.h"
+#include "watch.h"
+#ifdef __GNUC__
+#define _MAX_PATH PATH_MAX
+#endif
+#include "stats.h"
+#include "trace.h"
 
 
 void writeImdFile(const char *fname);
+void setImdStdout();
+void openImdStream(const char *fname);
+void flushImdStream(bool (*isPending)(int cyl, int head));
+void closeImdStream(bool discard);
 
 
 
@@ -53,18 +69,57 @@ static int histLevels = 0;
 static int options;
 static char const *userfmt;       // user specified format
 static char const *aopt;          // user specified analysis format
+static char const *summaryFile;   // set when run as a batch worker
+static unsigned watchCyls;        // cylinders expected in watch mode, 0 if not known
+static unsigned watchIdleSecs = WATCHIDLE;  // seconds without a track before the .imd file is brought up to date
+static char watchDirName[_MAX_PATH + 1];   // directory watched for .raw files
+static char watchName[_MAX_PATH + 5];      // the disk name used in watch mode, the directory name with .imd added
+static bool watchChanged;         // tracks decoded since the imd file was last written
 
 char const help[] =
-    "usage: %s [-b] [-d [=n]] [-f format] [-g] [-h [=n]] [-p] [-s] [zipfile|rawfile]+\n"
+    "usage: %s [-b] [-c dir] [-d [=n]] [-e dpll] [-f format] [-F file] [-g] [-h [=n]] [-i disk] [-j [=file]]\n"
+    "                [-k] [-l n] [-m [=[n][,s]]] [-n mb] [-o] [-p] [-q [=n]] [-r n[,mb]] [-s] [-t [=m]]\n"
+    "                [-u] [-w n] [-x] [-y] [zipfile|rawfile|scpfile|flxfile|directory|@manifest]+\n"
     "options can be in any order before the first file name\n"
     //"  -a encoding - undocumented option to help analyse new disk formats\n"
     "  -b      write bad (idam or data) sectors to the log file\n"
+    "  -c dir  caches decoded tracks in dir, unchanged tracks are not decoded again\n"
     "  -d [=n] sets debug flags to n (n is in hex) default is 1 which echos log to console\n"
+    "  -e dpll selects the dpll engine std (default), ctr or auto\n"
+    "          auto uses std and retries failing tracks with ctr\n"
     "  -f fmt  forces the specified format, use -f help for more info\n"
+    "  -F file loads format definitions from file, before any -f option\n"
     "  -g      write good (idam and data) sectors to the log file\n"
     "  -h [=n] displays flux histogram. n is optional number of levels\n"
+    "  -i disk decodes the files as captures of the same disk, good sectors from any\n"
+    "          capture are used in disk.imd. Complete tracks are not decoded again\n"
+    "  -j [=file] writes decode statistics to a .json file per input file\n"
+    "          or if file is given, for all input files to it\n"
+    "  -k      writes the flux statistics and interval histogram of each track to a .csv file\n"
+    "  -l n    limits the decode cache to n MB (default 512)\n"
+    "  -m [=[n][,s]] watch mode, decodes the .raw files written to the directory as they\n"
+    "          are completed. The .imd file is written once n cylinders have been decoded\n"
+    "          and whenever no new track has arrived for s seconds (default 60). The watch\n"
+    "          ends at such a pause once the n cylinders are done, or on Ctrl-C\n"
+    "  -n mb   limits the decoded track data held in memory to about mb MB. Beyond it fewer\n"
+    "          copies of bad sectors are kept and finished tracks are spilled to a temp file\n"
+    "  -o      writes the IMD file to stdout, e.g. to pipe it to another tool\n"
     "  -p      ignores parity bit in sector dump ascii display\n"
+    "  -q [=n] probe mode, shows a one line summary per file from a quick decode of\n"
+    "          the first revolution of every nth cylinder (default 8). No files are written\n"
+    "  -r n[,mb] reads up to n tracks ahead of the decoder (default 4) using up to\n"
+    "          mb MB (default 64). -r 0 reads each track when it is needed\n"
     "  -s      force writing of physical sector order in the log file\n"
+    "  -t [=m] writes a binary trace of the dpll & address mark matcher to a .trc file\n"
+    "          -t=m only traces the address marks found. Use trcdump to view it\n"
+    "  -u      skips files whose .imd (or .log if no .imd) is newer than the file\n"
+    "  -w n    batch mode, decodes the files using n worker processes and shows a summary\n"
+    "  -x      converts the files to compact .flx flux files, which are quicker to decode\n"
+    "  -y      writes the status and read position of each sector to a .sec.csv file\n"
+    //"  -z=file - internal option used by batch workers to return the summary\n"
+    "A directory is replaced by the .zip, .scp and .flx files in it, any .raw files in it\n"
+    "are decoded together as one disk. @manifest is replaced by the files listed in manifest,\n"
+    "one per line\n"
     "Note ZDS disks and rawfiles force -g as image files are not created\n"
 #ifdef _DEBUG
     "\nDebug options - add the hex values:\n"
@@ -74,11 +129,32 @@ char const help[] =
     ;
 
 
-static void decodeFile(const char *name) {
+// use the cached decode of the track if there is one
+static bool decodeTrack() {
+    if (loadCachedTrack(userfmt))
+        return true;
+    if (!flux2Track(userfmt))
+        return false;
+    saveCachedTrack(userfmt);
+    return true;
+}
+
+
+static bool decodeFile(const char *name, summary_t *summary) {
 
    if (openFluxFile(name)) {
         bool singleTrack = extMatch(name, ".raw");
+        if (isDir(name))
+            name = dirDiskName(name);   // the output files for a directory of .raw files are named from this
+        statsBeginFile(name);
+        traceOpen(name);
+        bool writeImd = !singleTrack && !aopt;
+        if (writeImd)
+            openImdStream(name);        // tracks are written as soon as they and those before them are done
+        uint64_t start = usClock();
         while (loadFluxStream()) {
+            uint64_t loaded = usClock();
+            stats.loadUs += loaded - start;
             if (histLevels)
                 displayHist(histLevels);
             if (aopt)
@@ -86,28 +162,238 @@ static void decodeFile(const char *name) {
                     analyse(aopt);
                 else
                     logFull(D_WARNING, "-a only supported for single .raw files\n");
-            else if (flux2Track(userfmt))
+            else if (decodeTrack()) {
                 displayTrack(getCyl(), getHead(), options | (singleTrack || noIMD() ? gOpt : 0));
+                summary->tracks++;
+                if (isTrackGood())
+                    summary->goodTracks++;
+            }
+            start = usClock();
+            stats.decodeUs += start - loaded;
+            statsEndTrack(getCyl(), getHead());
+            logEndTrack();
+            if (writeImd && curFormat && !noIMD()) {
+                flushImdStream(isTrackPending);
+                uint64_t written = usClock();
+                stats.writeUs += written - start;
+                start = written;
+            }
+            enforceBudget();
         }
    
+        traceClose();
         displayDefectMap();
         closeFluxFile();
 
-        if (!singleTrack && !noIMD())
-            writeImdFile(name);
+        if (writeImd) {
+            start = usClock();
+            closeImdStream(!curFormat || noIMD());
+            stats.writeUs += usClock() - start;
+        }
+        statsEndFile();
         removeDisk();
+        return true;
    }
+   return false;
 }
 
 
 
 
+/*
+ * decode the files as captures of the same disk into one disk model. Tracks already complete
+ * from earlier captures are not decoded again, otherwise the good sectors from the earlier
+ * captures fill in the gaps of the new decode. Each capture has its own log file, the fused
+ * disk's log has the sectors used from each capture and the defect map
+ */
+static bool fuseFiles(const char *diskName) {
+    char fusedName[_MAX_PATH + 5];
+    const char *captures[MAXCAPTURE];
+    unsigned used[MAXCAPTURE] = { 0 };
+    int skipped               = 0;
+
+    strcpy(fusedName, diskName);
+    if (!extMatch(fusedName, ".imd"))
+        strcat(fusedName, ".imd");
+    if (inputCnt() > MAXCAPTURE)
+        warn("Only the first %d captures are fused", MAXCAPTURE);
+    statsBeginFile(fusedName);
+    for (captureId = 0; captureId < inputCnt() && captureId < MAXCAPTURE; captureId++) {
+        captures[captureId] = getInput(captureId);
+        if (!openFluxFile(captures[captureId]))
+            continue;
+        uint64_t start = usClock();
+        while (loadFluxStream()) {
+            uint64_t loaded = usClock();
+            stats.loadUs += loaded - start;
+            int cyl = getCyl();
+            int head = getHead();
+            track_t *prev = cyl >= 0 && head >= 0 ? getTrack(cyl, head) : NULL;
+            if (prev && isTrackComplete(cyl, head)) {
+                logFull(ALWAYS, "Track complete from earlier captures, not decoded\n");
+                skipped++;
+            } else {
+                if (prev && restoreTrack(cyl, head))
+                    prev = getTrack(cyl, head);
+                if (decodeTrack()) {
+                    mergeTrack(prev);
+                    displayTrack(getCyl(), getHead(), options);
+                }
+            }
+            start = usClock();
+            stats.decodeUs += start - loaded;
+            statsEndTrack(getCyl(), getHead());
+            logEndTrack();
+            enforceBudget();
+        }
+        closeFluxFile();
+    }
+
+    createLogFile(fusedName);
+    for (int cyl = 0; cyl <= maxCylinder; cyl++)
+        for (int head = 0; head <= maxHead; head++) {
+            track_t *pTrack = getTrack(cyl, head);
+            for (int i = 0; pTrack && i < pTrack->fmt->spt; i++)
+                if (pTrack->sectors[i].status & SS_DATAGOOD)
+                    used[pTrack->sectors[i].capture]++;
+        }
+    logFull(ALWAYS, "Fused %d captures, %d tracks already complete were not decoded again\n", captureId, skipped);
+    for (int i = 0; i < captureId; i++)
+        logBasic("  capture %d %s: %u good sectors used\n", i + 1, captures[i], used[i]);
+    displayDefectMap();
+    bool ok = maxCylinder >= 0;
+    if (ok && curFormat && !noIMD()) {
+        uint64_t start = usClock();
+        writeImdFile(fusedName);
+        stats.writeUs += usClock() - start;
+    }
+    statsEndFile();
+    removeDisk();
+    captureId = 0;
+    return ok;
+}
+
+// transcode the flux streams of a file to a .flx file, no decoding is done
+static bool convertFile(const char *name) {
+    char flxName[_MAX_PATH + 5];
+
+    if (extMatch(name, ".flx")) {
+        logFull(D_WARNING, "%s is already a .flx file\n", name);
+        return false;
+    }
+    if (!openFluxFile(name))
+        return false;
+    strcpy(flxName, isDir(name) ? dirDiskName(name) : name);
+    strcpy(strrchr(flxName, '.'), ".flx");
+    bool ok = flxCreate(flxName);
+    if (ok) {
+        recordFlux(true);
+        while (ok && loadFluxStream())
+            ok = flxAddTrack();
+        ok = flxFinish() && ok;
+        recordFlux(false);
+    }
+    closeFluxFile();
+    if (ok)
+        printf("%s created\n", flxName);
+    return ok;
+}
+
+
+static bool isDiskComplete() {
+    if (watchCyls == 0 || maxCylinder + 1 < (int)watchCyls)
+        return false;
+    for (int cyl = 0; cyl < (int)watchCyls; cyl++)
+        for (int head = 0; head <= maxHead; head++)
+            if (!hasTrack(cyl, head))
+                return false;
+    return true;
+}
+
+static void updateImd() {
+    if (curFormat && !noIMD()) {
+        writeImdFile(watchName);
+        printf("%s updated\n", basename(watchName));
+        fflush(stdout);
+    }
+    watchChanged = false;
+}
+
+static bool watchTrack(const char *path) {
+    setLogPrefix(watchDirName, path);
+    if (!loadRawTrack(path))
+        return false;
+    uint64_t loaded = usClock();
+    if (decodeTrack()) {
+        displayTrack(getCyl(), getHead(), options);
+        printf("%s %s\n", basename(path), isTrackGood() ? "ok" : "has bad sectors");
+        watchChanged = true;
+    } else
+        printf("%s could not be decoded\n", basename(path));
+    fflush(stdout);                     // immediate feedback for the operator
+    stats.decodeUs += usClock() - loaded;
+    statsEndTrack(getCyl(), getHead());
+    logEndTrack();
+    if (watchChanged && isDiskComplete())
+        updateImd();
+    enforceBudget();
+    return true;
+}
+
+/*
+ * a pause in the capture may just be the operator retrying a track or turning the disk
+ * over, so an interim .imd file is written and the watch only ends if the disk is complete
+ */
+static bool watchIdle() {
+    if (maxCylinder < 0)
+        return false;                   // keep waiting for the first track
+    setLogPrefix(watchDirName, NULL);
+    if (watchChanged)
+        updateImd();
+    return isDiskComplete();
+}
+
+static bool watchDisk(const char *dir) {
+    if (!isDir(dir)) {
+        logFull(D_ERROR, "%s is not a directory\n", dir);
+        return false;
+    }
+    strcpy(watchName, dirDiskName(dir));
+    strcpy(watchDirName, watchName);
+    *strrchr(watchDirName, '.') = '\0';
+    createLogFile(watchName);
+    statsBeginFile(watchName);
+    printf("Watching %s for .raw files, Ctrl-C ends the watch\n", dir);
+    fflush(stdout);
+    bool result = watchDir(dir, watchIdleSecs, watchTrack, watchIdle);
+    setLogPrefix(watchDirName, NULL);
+    if (watchChanged)                   // ended by Ctrl-C with tracks not yet written
+        updateImd();
+    displayDefectMap();
+    statsEndFile();
+    removeDisk();
+    createLogFile(NULL);
+    return result;
+}
+
+
 int main(int argc, char** argv) {
     char *endPtr;
+    int workers = 0;
+    bool update = false;
+    bool jsonOpt = false;
+    char const *jsonFile = NULL;
+    char const *cacheDir = NULL;
+    unsigned cacheLimit  = 512;
+    unsigned probeStep   = 0;
+    bool watch           = false;
+    bool toStdout        = false;
+    bool convert         = false;
+    char const *fuseName = NULL;
 
     createLogFile(NULL);
 
-    while (getopt(argc, argv, "a:bd=f:gh=ps") != EOF) {
+    while (getopt(argc, argv, "a:bc:d=e:f:F:gh=i:j=kl:m=n:opq=r:st=uw:xyz=") != EOF) {
         switch (optopt) {
         case 'g':
             options |= gOpt;
@@ -118,6 +404,19 @@ int main(int argc, char** argv) {
         case 's':
             options |= sOpt;
             break;
+        case 't':
+            if (optarg && stricmp(optarg, "m") != 0)
+                usage("Invalid trace option '%s' for -t option", optarg);
+            traceLevel = optarg ? TRACE_MATCH : TRACE_ALL;
+            break;
+        case 'c':
+            cacheDir = optarg;
+            break;
+        case 'l':
+            cacheLimit = (unsigned)strtoul(optarg, &endPtr, 10);
+            if (*endPtr || cacheLimit == 0)
+                usage("Invalid cache limit '%s' for -l option", optarg);
+            break;
         case 'd':
             if (optarg) {
                 debug = (unsigned)strtoul(optarg, &endPtr, 16);
@@ -138,14 +437,92 @@ int main(int argc, char** argv) {
             } else
                 histLevels = 10;
             break;
+        case 'j':
+            jsonOpt  = true;
+            jsonFile = optarg;
+            break;
+        case 'i':
+            fuseName = optarg;
+            break;
+        case 'k':
+            statsCsv();
+            break;
+        case 'n': {
+            unsigned budgetMB = (unsigned)strtoul(optarg, &endPtr, 10);
+            if (*endPtr || budgetMB == 0)
+                usage("Invalid memory budget '%s' for -n option", optarg);
+            setMemoryBudget((size_t)budgetMB * 1024 * 1024);
+            break;
+        }
+        case 'u':
+            update = true;
+            break;
+        case 'w':
+            workers = (int)strtoul(optarg, &endPtr, 10);
+            if (*endPtr || workers < 1)
+                usage("Invalid worker count '%s' for -w option", optarg);
+            break;
+        case 'x':
+            convert = true;
+            break;
+        case 'y':
+            statsSectors();
+            break;
+        case 'z':
+            summaryFile = optarg;
+            break;
+        case 'r': {
+            unsigned depth = (unsigned)strtoul(optarg, &endPtr, 10);
+            unsigned limitMB = 64;
+            if (*endPtr == ',')
+                limitMB = (unsigned)strtoul(endPtr + 1, &endPtr, 10);
+            if (*endPtr || limitMB == 0)
+                usage("Invalid read ahead '%s' for -r option", optarg);
+            setReadAhead(depth, limitMB);
+            break;
+        }
+        case 'm':
+            watch = true;
+            if (optarg) {
+                endPtr = (char *)optarg;
+                if (*optarg != ',') {
+                    watchCyls = (unsigned)strtoul(optarg, &endPtr, 10);
+                    if ((*endPtr && *endPtr != ',') || watchCyls == 0 || watchCyls > MAXCYLINDER)
+                        usage("Invalid cylinder count '%s' for -m option", optarg);
+                }
+                if (*endPtr == ',') {
+                    watchIdleSecs = (unsigned)strtoul(endPtr + 1, &endPtr, 10);
+                    if (*endPtr || watchIdleSecs == 0 || watchIdleSecs > 24 * 3600)
+                        usage("Invalid idle time '%s' for -m option", optarg);
+                }
+            }
+            break;
+        case 'o':
+            toStdout = true;
+            break;
         case 'p':
             options |= pOpt;
             break;
+        case 'q':
+            probeStep = 8;
+            if (optarg) {
+                probeStep = (unsigned)strtoul(optarg, &endPtr, 10);
+                if (*endPtr || probeStep == 0)
+                    usage("Invalid cylinder step '%s' for -q option", optarg);
+            }
+            break;
+        case 'e':
+            if (!selectDpll(optarg))
+                usage("Invalid dpll engine '%s' for -e option", optarg);
+            break;
         case 'f':
             userfmt = optarg;
             if (stricmp(userfmt, "help") == 0)
                 showFormats();
             break;
+        case 'F':
+            loadFormats(optarg);
+            break;
         case 'a':
             aopt = optarg;
             break;
@@ -154,12 +531,87 @@ int main(int argc, char** argv) {
             usage("invalid option -%c", optopt);
         }
     }
+    // the pattern & address mark debug options are written to the binary trace
+    if (debug & D_PATTERN)
+        traceLevel = TRACE_ALL;
+    else if ((debug & D_ADDRESSMARK) && traceLevel == TRACE_OFF)
+        traceLevel = TRACE_MATCH;
     if (aopt && userfmt)
         usage("-a and -f cannot be both specified");
     if (optind >= argc)
         usage("No files to process");
 
+    if (toStdout) {
+        if (optind + 1 != argc || workers || probeStep || watch)
+            usage("-o needs a single file and cannot be used with -m, -q or -w");
+        setImdStdout();
+    }
+
+    if (watch) {
+        if (optind + 1 != argc || workers || probeStep)
+            usage("-m needs a single directory and cannot be used with -q or -w");
+        if (jsonOpt)
+            statsOpen(jsonFile);
+        bool ok = watchDisk(argv[optind]);
+        statsClose();
+        return ok ? 0 : 1;
+    }
+
+    int firstInput = optind;
     while (optind < argc)
-        decodeFile(argv[optind++]);
-    return 0;
+        addInput(argv[optind++]);
+
+    if (fuseName) {
+        if (workers || probeStep || convert || toStdout)
+            usage("-i cannot be used with -o, -q, -w or -x");
+        if (cacheDir)
+            cacheOpen(cacheDir, cacheLimit);
+        if (jsonOpt)
+            statsOpen(jsonFile);
+        bool ok = fuseFiles(fuseName);
+        statsClose();
+        return ok ? 0 : 1;
+    }
+
+    if (convert) {
+        int status = 0;
+        enableLogFiles(false);
+        for (int i = 0; i < inputCnt(); i++)
+            if (!convertFile(getInput(i)))
+                status = 1;
+        return status;
+    }
+
+    if (probeStep) {
+        int status = 0;
+        setTrackStep(probeStep);
+        enableLogFiles(false);
+        probeHeader();
+        for (int i = 0; i < inputCnt(); i++)
+            if (!probeFile(getInput(i), userfmt))
+                status = 1;
+        return status;
+    }
+
+    if (workers && !summaryFile) {
+        runBatch(argv, firstInput, workers, update, jsonOpt && jsonFile && *jsonFile ? jsonFile : NULL);
+        return 0;
+    }
+    if (cacheDir)
+        cacheOpen(cacheDir, cacheLimit);
+    if (jsonOpt)
+        statsOpen(summaryFile ? NULL : jsonFile);   // batch workers write a .json per file for the runner to merge
+
+    int status = 0;
+    for (int i = 0; i < inputCnt(); i++) {
+        summary_t summary = { 0, 0 };
+        if (update && isUpToDate(getInput(i)))
+            logFull(ALWAYS, "%s is up to date\n", getInput(i));
+        else if (!decodeFile(getInput(i), &summary))
+            status = 1;
+        else if (summaryFile && !writeSummary(summaryFile, &summary))
+            status = 1;
+    }
+    statsClose();
+    return status;
 }
\ No newline at end of file
@@ -32,6 +32,7 @@
 void assumeIMD();
 bool flux2Track(char const *usrfmt);
 bool noIMD();
+bool probeTrack(char const *usrfmt);
 
 // display.c
 void displayDefectMap();
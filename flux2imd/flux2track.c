@@ -0,0 +1,140 @@
+/****************************************************************************
+ *  program: flux2imd - create imd image file from kryoflux file            *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+    flux2track - per track analysis of flux files
+
+    Decodes each track of the kryoflux, scp or flx file and writes the track's sector
+    map and sector dumps to the log file; no IMD file is created. It is built from the
+    flux2imd modules, so the ingest, dpll and decoders are the same as flux2imd's.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "container.h"
+#include "dpll.h"
+#include "flux2imd.h"
+#include "stdflux.h"
+#include "util.h"
+#include "utility.h"
+
+char const help[] =
+    "usage: %s [-a encoding] [-b] [-d [=n]] [-e dpll] [-f format] [-h [=n]] [-p] [-s]\n"
+    "                [zipfile|rawfile|scpfile|flxfile|directory]+\n"
+    "options can be in any order before the first file name\n"
+    "  -a enc  dumps the raw bit stream of each track using the given encoding\n"
+    "  -b      write bad (idam or data) sectors to the log file\n"
+    "  -d [=n] sets debug flags to n (n is in hex) default is 1 which echos log to console\n"
+    "  -e dpll selects the dpll engine std (default), ctr or auto\n"
+    "  -f fmt  forces the specified format, use flux2imd -f help for more info\n"
+    "  -h [=n] displays flux histogram. n is optional number of levels\n"
+    "  -p      ignores parity bit in sector dump ascii display\n"
+    "  -s      force writing of physical sector order in the log file\n"
+    "Good sectors are always written to the log file\n";
+
+static int histLevels;
+static int options = gOpt;
+static char const *userfmt;
+static char const *aopt;
+
+static void analyseFile(const char *name) {
+    if (!openFluxFile(name))
+        return;
+    while (loadFluxStream()) {
+        if (histLevels)
+            displayHist(histLevels);
+        if (aopt)
+            analyse(aopt);
+        else if (flux2Track(userfmt))
+            displayTrack(getCyl(), getHead(), options);
+        logEndTrack();
+    }
+    closeFluxFile();
+    removeDisk();
+}
+
+int main(int argc, char **argv) {
+    char *endPtr;
+
+    createLogFile(NULL);
+    while (getopt(argc, argv, "a:bd=e:f:gh=ps") != EOF) {
+        switch (optopt) {
+        case 'a':
+            aopt = optarg;
+            break;
+        case 'b':
+            options |= bOpt;
+            break;
+        case 'd':
+            if (optarg) {
+                debug = (unsigned)strtoul(optarg, &endPtr, 16);
+                if (*endPtr) {
+                    warn("Invalid hex value '%s' for -d option", optarg);
+                    debug = D_ECHO;
+                }
+            } else
+                debug = D_ECHO;
+            break;
+        case 'e':
+            if (!selectDpll(optarg))
+                usage("Invalid dpll engine '%s' for -e option", optarg);
+            break;
+        case 'f':
+            userfmt = optarg;
+            break;
+        case 'g':                       // accepted for compatibility, good sectors are always written
+            break;
+        case 'h':
+            if (optarg) {
+                histLevels = (int)strtoul(optarg, &endPtr, 10);
+                if (*endPtr)
+                    warn("Invalid numeric value '%s' for -h  option", optarg);
+                if (histLevels <= 5)
+                    histLevels = 10;
+            } else
+                histLevels = 10;
+            break;
+        case 'p':
+            options |= pOpt;
+            break;
+        case 's':
+            options |= sOpt;
+            break;
+        default:
+            usage("invalid option -%c", optopt);
+        }
+    }
+    if (optind >= argc)
+        usage("No files to process");
+    if (aopt && userfmt)
+        usage("-a and -f cannot be both specified");
+
+    for (; optind < argc; optind++)
+        analyseFile(argv[optind]);
+    return 0;
+}
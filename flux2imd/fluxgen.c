@@ -0,0 +1,791 @@
+/****************************************************************************
+ *  program: flux2imd - create imd image file from kryoflux file            *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+    fluxgen - synthetic flux generator and decode benchmark for flux2imd
+
+    Creates KryoFlux (.zip) or SuperCard Pro (.scp) captures for the soft sector
+    formats in formatInfo[], with optional jitter, rpm drift, weak bits and missing
+    sectors. The sector payload is a simple function of cylinder, head, sector and
+    offset, so the decoded image can be checked without a reference copy.
+
+    In benchmark mode (-b) each concrete format is generated in both containers and
+    decoded using the flux2imd modules, reporting the throughput of each stage and
+    checking that the IMD file written matches the generated payload.
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _MSC_VER
+#include <limits.h>
+#define _MAX_PATH   PATH_MAX
+#endif
+
+#include "container.h"
+#include "flux.h"
+#include "flux2imd.h"
+#include "formats.h"
+#include "readahead.h"
+#include "scp.h"
+#include "stats.h"
+#include "stdflux.h"
+#include "util.h"
+#include "utility.h"
+#include "zip.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// KryoFlux sample & index clocks
+#define SCK           24027428.5714285
+#define ICK           (SCK / 8)
+#define SCPCLK        40e6                  // 25ns SCP resolution
+
+#define MAXTRACKBYTES 13000                 // 500kbps at 300rpm is 12500
+#define MAXREVS       6                     // flux.c supports up to 8 indexes
+#define MAXDEFECTS    64
+#define KF_OOB        0xd
+
+char const help[] =
+    "usage: %s [-b] [-c cyls] [-d drift] [-f format] [-j jitter] [-m cnt] [-n iter] [-p speed]\n"
+    "               [-r revs] [-s sides] [-t slew] [-w cnt] [-x seed] [file.zip|file.scp]\n"
+    "  -b         run the decode benchmark, instead of writing a file\n"
+    "  -c cyls    number of cylinders, default 77 for 8\" formats, else 40 (20 for -b)\n"
+    "  -d drift   peak rpm drift as a percentage, default 0\n"
+    "  -f format  format to generate, default MFM5-16x256. Use -f help for the list\n"
+    "  -j jitter  standard deviation of flux jitter in ns, default 0 (-b uses 3%% of cell)\n"
+    "  -m cnt     number of sectors to omit\n"
+    "  -n iter    number of decode iterations per benchmark format, default 1\n"
+    "  -p speed   capture drive speed error as a percentage, +ve is fast, default 0\n"
+    "  -r revs    revolutions per track 1-6, default 3\n"
+    "  -s sides   1 or 2, default 2\n"
+    "  -t slew    change in capture drive speed per revolution as a percentage, default 0\n"
+    "  -w cnt     number of sectors with weak bits in their data\n"
+    "  -x seed    seed for the random numbers, default 1\n"
+    "Note for a file the extent .zip creates KryoFlux raw tracks, .scp creates a SuperCard Pro image\n";
+
+// user options
+static int cylinders;
+static int sides   = 2;
+static int revs    = 3;
+static double drift;
+static double speedError;
+static double slew;
+static double jitter = -1.0;
+static int cntMissing;
+static int cntWeak;
+static int iterations = 1;
+static uint32_t seed  = 1;
+
+static formatInfo_t *fmt;
+
+enum { G_FM, G_MFM, G_M2FM };
+static int family;
+
+// random numbers, own generator so results are the same on all platforms
+static uint32_t rndState;
+
+static uint32_t rnd32() {
+    rndState ^= rndState << 13;
+    rndState ^= rndState >> 17;
+    rndState ^= rndState << 5;
+    return rndState;
+}
+
+static double rndUniform() { // (0,1)
+    return (rnd32() + 1.0) / 4294967297.0;
+}
+
+static double rndGauss() {
+    return sqrt(-2 * log(rndUniform())) * cos(2 * M_PI * rndUniform());
+}
+
+// sectors selected to be missing or to have weak bits
+typedef struct {
+    int cylinder;
+    int head;
+    int slot;
+} defect_t;
+
+static defect_t missing[MAXDEFECTS];
+static defect_t weak[MAXDEFECTS];
+
+static bool isDefect(defect_t *list, int cnt, int cylinder, int head, int slot) {
+    for (int i = 0; i < cnt; i++)
+        if (list[i].cylinder == cylinder && list[i].head == head && list[i].slot == slot)
+            return true;
+    return false;
+}
+
+static void chooseDefects(defect_t *list, int cnt, defect_t *other, int otherCnt) {
+    for (int i = 0; i < cnt; i++) {
+        defect_t *p = &list[i];
+        do {
+            p->cylinder = rnd32() % cylinders;
+            p->head     = rnd32() % sides;
+            p->slot     = rnd32() % fmt->spt;
+        } while (isDefect(list, i, p->cylinder, p->head, p->slot) ||
+                 isDefect(other, otherCnt, p->cylinder, p->head, p->slot));
+    }
+}
+
+// the generated sector content
+static uint8_t payload(int cylinder, int head, int sectorId, int i) {
+    return (uint8_t)(cylinder * 7 + head * 13 + sectorId * 31 + i + seed);
+}
+
+static bool is8Inch() {
+    return fmt->encoding == E_FM8 || fmt->encoding == E_MFM8 || fmt->encoding == E_M2FM8;
+}
+
+static double rpm() {
+    return is8Inch() ? 360.0 : 300.0;
+}
+
+static int trackBytes() {
+    return (int)(60e9 / rpm() / (fmt->nominalCellSize * 16.0));
+}
+
+static bool isSupported(formatInfo_t *p) {
+    if (p->options & ~(O_SIZE | O_SPC | O_UINV))
+        return false;
+    return p->spt && p->spacing && (p->encoding == E_FM5 || p->encoding == E_FM8 || p->encoding == E_MFM5 ||
+                                    p->encoding == E_MFM8 || p->encoding == E_M2FM8);
+}
+
+static void listFormats() {
+    printf("Formats supported by fluxgen, ** marks those skipped by the benchmark\n");
+    for (formatInfo_t *p = formatInfo; p->name; p++)
+        if (p->description && isSupported(p))
+            printf("    %-12s  %s\n", p->name, p->description);
+    exit(0);
+}
+
+/*
+ * track construction
+ * the track is built as a sequence of cells, 16 per byte, using the same clock bit rules as encode()
+ */
+static uint8_t cells[MAXTRACKBYTES * 16];
+static int cellCnt;
+static uint32_t pattern;
+static unsigned clockMask;
+static uint16_t crc;
+static int weakStart, weakEnd;          // cell range of weak bits, if any
+
+static void putCell(int cell) {
+    if (cellCnt < (int)sizeof(cells))
+        cells[cellCnt++] = cell;
+    pattern = (pattern << 1) | cell;
+}
+
+static void putRaw(uint16_t word) {
+    for (uint16_t mask = 0x8000; mask; mask >>= 1)
+        putCell((word & mask) != 0);
+}
+
+static void putByte(uint8_t val) {
+    for (uint8_t mask = 0x80; mask; mask >>= 1) {
+        unsigned dbit = (val & mask) != 0;
+        putCell((((pattern << 2) | dbit) & clockMask) == 0);
+        putCell(dbit);
+    }
+}
+
+static void crcByte(uint8_t val) {
+    uint8_t x = (crc >> 8) ^ val;
+    x ^= x >> 4;
+    crc = (crc << 8) ^ (x << 12) ^ (x << 5) ^ x;
+}
+
+static void putCrcByte(uint8_t val) {
+    crcByte(val);
+    putByte(val);
+}
+
+static void putCrc() {
+    uint16_t val = crc;
+    putByte(val >> 8);
+    putByte(val & 0xff);
+}
+
+static int curByte() {
+    return cellCnt / 16;
+}
+
+static void putGap(int toByte) {
+    uint8_t gap = family == G_FM ? 0xff : family == G_MFM ? 0x4e : 0;
+    while (curByte() < toByte)
+        putByte(gap);
+}
+
+// bytes used by the sync and address mark
+static int markLen() {
+    return family == G_FM ? 7 : family == G_MFM ? 16 : 8;
+}
+
+static void putMark(int am) {
+    int i;
+    crc = fmt->crcInit;
+
+    switch (family) {
+    case G_FM:
+        for (i = 0; i < 6; i++)
+            putByte(0);
+        putRaw(am == INDEXAM ? 0xf77a : am == IDAM ? 0xf57e : 0xf56f);
+        crcByte(am);
+        break;
+    case G_MFM:
+        for (i = 0; i < 12; i++)
+            putByte(0);
+        for (i = 0; i < 3; i++)
+            putRaw(am == INDEXAM ? 0x5224 : 0x4489);
+        putCrcByte(am);                 // crcInit already includes the A1 bytes
+        break;
+    case G_M2FM:
+        for (i = 0; i < 7; i++)
+            putByte(0);
+        putByte(0xff);
+        am = am == INDEXAM ? M2FM_INDEXAM : am == IDAM ? M2FM_IDAM : M2FM_DATAAM;
+        putRaw(am == M2FM_INDEXAM ? 0x2a52 : am == M2FM_IDAM ? 0x2a54 : 0x2a45);
+        crcByte(am);
+        break;
+    }
+}
+
+static void buildTrack(int cylinder, int head) {
+    int sectorLen = 128 << fmt->sSize;
+    int gap2      = family == G_MFM ? 22 : 11;
+
+    cellCnt   = 0;
+    pattern   = 0;
+    weakStart = weakEnd = 0;
+    clockMask = family == G_FM ? 0 : family == G_MFM ? 5 : 0xd;
+
+    if (family != G_M2FM && fmt->firstIDAM > 2 * markLen() + 10) {
+        putGap(fmt->firstIDAM - 2 * markLen() - 10);
+        putMark(INDEXAM);
+    }
+    for (int slot = 0; slot < fmt->spt; slot++) {
+        int sectorId = fmt->firstSectorId + slot;
+        putGap(fmt->firstIDAM + slot * fmt->spacing - markLen());
+        if (isDefect(missing, cntMissing, cylinder, head, slot))
+            continue;
+        putMark(IDAM);
+        putCrcByte(cylinder);
+        putCrcByte(head);
+        putCrcByte(sectorId);
+        putCrcByte(fmt->sSize);
+        putCrc();
+
+        int dataPos = curByte() + gap2 + markLen();
+        if (dataPos < fmt->firstDATA + slot * fmt->spacing)
+            dataPos = fmt->firstDATA + slot * fmt->spacing;
+        putGap(dataPos - markLen());
+        putMark(DATAAM);
+        if (isDefect(weak, cntWeak, cylinder, head, slot)) {
+            weakStart = cellCnt + 16 * (sectorLen / 2);
+            weakEnd   = weakStart + 16 * 4;
+        }
+        for (int i = 0; i < sectorLen; i++) {
+            uint8_t val = payload(cylinder, head, sectorId, i);
+            putCrcByte((fmt->options & O_UINV) ? ~val : val);
+        }
+        putCrc();
+    }
+    if (curByte() > trackBytes())
+        fatal("%s does not fit on a %d rpm track\n", fmt->name, (int)rpm());
+    putGap(trackBytes());
+}
+
+/*
+ * flux generation
+ * times are in ns from the start of the capture, with revs + 1 index pulses
+ * the capture starts part way through the previous revolution as a real drive would
+ */
+static double *fluxTs;
+static int fluxCnt;
+static int fluxSize;
+static double indexTs[MAXREVS + 1];
+
+static void addFlux(double ts) {
+    if (fluxCnt >= fluxSize) {
+        fluxSize = fluxSize ? fluxSize * 2 : 0x40000;
+        fluxTs   = (double *)safeRealloc(fluxTs, fluxSize * sizeof(double));
+    }
+    if (fluxCnt == 0 || ts > fluxTs[fluxCnt - 1])
+        fluxTs[fluxCnt++] = ts;
+}
+
+static void emitCells(int from, int to, double *ts, int rev) {
+    double cellNs = fmt->nominalCellSize;
+    for (int i = from; i < to; i++) {
+        double speed = 1.0 + drift / 100.0 * sin(2 * M_PI * i / cellCnt + rev * 1.3);
+        double drive = 1.0 + (speedError + slew * (rev + (double)i / cellCnt)) / 100.0;   // capture drive's own speed
+        *ts += cellNs * speed / drive;
+        if (cells[i]) {
+            double ts1 = *ts;
+            if (i >= weakStart && i < weakEnd) {
+                if (rnd32() % 4 == 0)           // weak bits, sometimes missing otherwise poorly placed
+                    continue;
+                ts1 += (rndUniform() - 0.5) * cellNs;
+            }
+            addFlux(ts1 + jitter * rndGauss());
+        }
+    }
+}
+
+static void genFlux() {
+    double ts = 0;
+    fluxCnt   = 0;
+    emitCells(cellCnt * 7 / 8, cellCnt, &ts, -1);          // lead in
+    for (int rev = 0; rev < revs; rev++) {
+        indexTs[rev] = ts;
+        emitCells(0, cellCnt, &ts, rev);
+    }
+    indexTs[revs] = ts;
+    emitCells(0, cellCnt / 16, &ts, revs);                  // lead out
+}
+
+/*
+ * KryoFlux stream
+ */
+static uint8_t *kfBuf;
+static uint32_t kfLen;
+static uint32_t kfSize;
+static uint32_t streamPos;
+
+static void kfPut(uint8_t val, bool isStream) {
+    if (kfLen >= kfSize) {
+        kfSize = kfSize ? kfSize * 2 : 0x100000;
+        kfBuf  = (uint8_t *)safeRealloc(kfBuf, kfSize);
+    }
+    kfBuf[kfLen++] = val;
+    if (isStream)
+        streamPos++;
+}
+
+static void kfPut32(uint32_t val) {
+    for (int i = 0; i < 32; i += 8)
+        kfPut((uint8_t)(val >> i), false);
+}
+
+static void kfOob(int type, uint16_t len) {
+    kfPut(KF_OOB, false);
+    kfPut(type, false);
+    kfPut(len & 0xff, false);
+    kfPut(len >> 8, false);
+}
+
+static void kfFlux(uint32_t val) {
+    while (val >= 0x10000) {
+        kfPut(0xb, true); // Ovl16
+        val -= 0x10000;
+    }
+    if (val >= 0xe && val <= 0xff)
+        kfPut(val, true);
+    else if (val < 0x800) {
+        kfPut(val >> 8, true);
+        kfPut(val & 0xff, true);
+    } else {
+        kfPut(0xc, true); // Flux3
+        kfPut(val >> 8, true);
+        kfPut(val & 0xff, true);
+    }
+}
+
+static void makeKryoFlux() {
+    static const char info[] = "sck=24027428.5714285, ick=3003428.5714285625";
+    double tickNs            = 1e9 / SCK;
+    uint64_t prevTick        = 0;
+    int rev                  = 0;
+
+    kfLen = streamPos = 0;
+    kfOob(4, sizeof(info) - 1);
+    for (const char *s = info; *s; s++)
+        kfPut(*s, false);
+
+    for (int i = 0; i < fluxCnt; i++) {
+        uint64_t tick = (uint64_t)(fluxTs[i] / tickNs + 0.5);
+        while (rev <= revs && indexTs[rev] < fluxTs[i]) {
+            kfOob(2, 12);
+            kfPut32(streamPos);
+            kfPut32((uint32_t)((uint64_t)(indexTs[rev] / tickNs) - prevTick));
+            kfPut32((uint32_t)(indexTs[rev] * ICK / 1e9));
+            rev++;
+        }
+        kfFlux((uint32_t)(tick - prevTick));
+        prevTick = tick;
+    }
+    kfOob(3, 8);
+    kfPut32(streamPos);
+    kfPut32(0);
+    kfOob(0xd, 0x0d0d);
+}
+
+static bool writeZip(const char *fname) {
+    struct zip_t *zip = zip_open(fname, ZIP_DEFAULT_COMPRESSION_LEVEL, 'w');
+    if (!zip)
+        return false;
+    for (int cylinder = 0; cylinder < cylinders; cylinder++)
+        for (int head = 0; head < sides; head++) {
+            char name[32];
+            buildTrack(cylinder, head);
+            genFlux();
+            makeKryoFlux();
+            sprintf(name, "track%02d.%d.raw", cylinder, head);
+            zip_entry_open(zip, name);
+            zip_entry_write(zip, kfBuf, kfLen);
+            zip_entry_close(zip);
+        }
+    zip_close(zip);
+    return true;
+}
+
+/*
+ * SuperCard Pro image, all tracks are index aligned
+ */
+static void put32(uint8_t *p, uint32_t val) {
+    for (int i = 0; i < 4; i++)
+        p[i] = (uint8_t)(val >> (i * 8));
+}
+
+static bool writeScp(const char *fname) {
+    FILE *fp;
+    uint8_t header[IFF_THDSTART] = { 'S', 'C', 'P', 0x19, man_Other };
+    uint8_t trkHeader[4 + MAXREVS * 12];
+    uint32_t checksum = 0;
+    int lastTrack     = (cylinders - 1) * 2 + sides - 1;
+
+    if (!(fp = fopen(fname, "wb+")))
+        return false;
+    header[IFF_NUMREVS]  = revs;
+    header[IFF_START]    = 0;
+    header[IFF_END]      = lastTrack;
+    header[IFF_FLAGS]    = (1 << FB_INDEX) | (is8Inch() ? 1 << FB_RPM : 0);
+    header[IFF_HEADS]    = sides == 1 ? 1 : 0;
+    fwrite(header, 1, sizeof(header), fp);
+
+    for (int cylinder = 0; cylinder < cylinders; cylinder++)
+        for (int head = 0; head < sides; head++) {
+            int trk        = cylinder * 2 + head;
+            uint32_t start = (uint32_t)ftell(fp);
+            put32(header + IFF_THDOFFSET + trk * 4, start);
+
+            buildTrack(cylinder, head);
+            genFlux();
+            memcpy(trkHeader, "TRK", 3);
+            trkHeader[3]    = trk;
+            uint32_t offset = 4 + revs * 12;
+            fseek(fp, start + offset, SEEK_SET);
+
+            int i = 0;
+            for (int rev = 0; rev < revs; rev++) {
+                uint64_t prevTick = (uint64_t)(indexTs[rev] * SCPCLK / 1e9);
+                uint32_t cnt      = 0;
+                for (; i < fluxCnt && fluxTs[i] < indexTs[rev]; i++)
+                    ;
+                for (; i < fluxCnt && fluxTs[i] < indexTs[rev + 1]; i++) {
+                    uint64_t tick  = (uint64_t)(fluxTs[i] * SCPCLK / 1e9 + 0.5);
+                    uint32_t delta = (uint32_t)(tick - prevTick);
+                    for (; delta > 0xffff; delta -= 0x10000, cnt++) {
+                        putc(0, fp);
+                        putc(0, fp);
+                    }
+                    putc(delta >> 8, fp);
+                    putc(delta & 0xff, fp);
+                    prevTick = tick;
+                    cnt++;
+                }
+                put32(trkHeader + 4 + rev * 12, (uint32_t)((indexTs[rev + 1] - indexTs[rev]) * SCPCLK / 1e9));
+                put32(trkHeader + 8 + rev * 12, cnt);
+                put32(trkHeader + 12 + rev * 12, offset);
+                offset += cnt * 2;
+            }
+            fseek(fp, start, SEEK_SET);
+            fwrite(trkHeader, 1, 4 + revs * 12, fp);
+            fseek(fp, 0, SEEK_END);
+        }
+    // fix up the header and the checksum
+    fseek(fp, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), fp);
+    fseek(fp, IFF_THDOFFSET, SEEK_SET);
+    for (int c; (c = getc(fp)) != EOF;)
+        checksum += c;
+    put32(header + IFF_CHECKSUM, checksum);
+    fseek(fp, 0, SEEK_SET);
+    fwrite(header, 1, IFF_THDOFFSET, fp);
+    fclose(fp);
+    return true;
+}
+
+static bool generate(const char *fname) {
+    rndState = seed ? seed : 1;
+    chooseDefects(missing, cntMissing, NULL, 0);
+    chooseDefects(weak, cntWeak, missing, cntMissing);
+    const char *s = strrchr(fname, '.');
+    if (s && stricmp(s, ".zip") == 0)
+        return writeZip(fname);
+    if (s && stricmp(s, ".scp") == 0)
+        return writeScp(fname);
+    fatal("%s: file extent must be .zip or .scp\n", fname);
+}
+
+/*
+ * check an IMD file against the generated payload
+ * returns the number of sectors in error, i.e. wrong data or bad sectors that were not deliberately damaged
+ */
+static int verifyImd(const char *fname, int *cntGood) {
+    FILE *fp;
+    int c;
+    int errors = 0;
+    int seen   = 0;
+    uint8_t smap[256];
+    uint8_t data[1024];
+
+    *cntGood = 0;
+    if (!(fp = fopen(fname, "rb")))
+        return cylinders * sides * fmt->spt;
+    while ((c = getc(fp)) != EOF && c != 0x1a)
+        ;
+    while (getc(fp) != EOF) {   // mode
+        int cylinder = getc(fp);
+        int head     = getc(fp);
+        int spt      = getc(fp);
+        int sSize    = getc(fp);
+        if (sSize < 0 || sSize > 3 || spt < 0 || fread(smap, 1, spt, fp) != (size_t)spt)
+            break;
+        if (head & 0x80)
+            fseek(fp, spt, SEEK_CUR);
+        if (head & 0x40)
+            fseek(fp, spt, SEEK_CUR);
+        head &= 1;
+        int len = 128 << sSize;
+        for (int i = 0; i < spt; i++, seen++) {
+            int type = getc(fp);
+            if (type == 0)
+                memset(data, 0, len);
+            else if (type % 2 == 0)
+                memset(data, getc(fp), len);
+            else if (fread(data, 1, len, fp) != (size_t)len)
+                break;
+            bool ok = type > 0;
+            for (int j = 0; ok && j < len; j++)
+                ok = data[j] == payload(cylinder, head, smap[i], j);
+            int slot = smap[i] - fmt->firstSectorId;
+            if (ok)
+                ++*cntGood;
+            else if (type != 0 || !(isDefect(missing, cntMissing, cylinder, head, slot) ||
+                                    isDefect(weak, cntWeak, cylinder, head, slot)))
+                errors++;
+        }
+    }
+    fclose(fp);
+    return errors + cylinders * sides * fmt->spt - seen;
+}
+
+/*
+ * benchmark
+ */
+static double seconds(uint64_t us) {
+    return us / 1e6;
+}
+
+static double rate(double val, double secs) {
+    return secs > 0 ? val / secs : 0.0;
+}
+
+static long fileSize(const char *fname) {
+    FILE *fp = fopen(fname, "rb");
+    long size = 0;
+    if (fp) {
+        fseek(fp, 0, SEEK_END);
+        size = ftell(fp);
+        fclose(fp);
+    }
+    return size;
+}
+
+// the bench files go in the temporary directory, so an interrupted run leaves nothing behind here
+static const char *tempDir() {
+    const char *dir = getenv("TMPDIR");
+    if (!dir || !*dir)
+        dir = getenv("TEMP");
+    return dir && *dir ? dir : "/tmp";
+}
+
+static void benchFormat(const char *ext) {
+    char fname[_MAX_PATH + 1];
+    char imdName[_MAX_PATH + 1];
+    char logName[_MAX_PATH + 1];
+    uint64_t ingest = 0, decode = 0, write = 0;
+    uint64_t fluxBytes = 0;
+    int tracks         = 0;
+    int good           = 0;
+    int errors         = 0;
+
+    snprintf(fname, sizeof(fname), "%s/bench_%s%s", tempDir(), fmt->name, ext);
+    strcpy(imdName, fname);
+    strcpy(strrchr(imdName, '.'), ".imd");
+    strcpy(logName, fname);
+    strcpy(strrchr(logName, '.'), ".log");
+
+    uint64_t start = usClock();
+    if (!generate(fname)) {
+        printf("%-12s %-4s cannot create %s\n", fmt->name, ext + 1, fname);
+        return;
+    }
+    uint64_t gen = usClock() - start;
+
+    for (int iter = 0; iter < iterations; iter++) {
+        if (!openFluxFile(fname))
+            break;
+        for (;;) {
+            start       = usClock();
+            bool loaded = loadFluxStream();
+            ingest += usClock() - start;
+            if (!loaded)
+                break;
+            tracks++;
+            start = usClock();
+            flux2Track(fmt->name);
+            decode += usClock() - start;
+        }
+        start = usClock();
+        writeImdFile(fname);
+        write += usClock() - start;
+        removeDisk();
+        closeFluxFile();
+        fluxBytes += fileSize(fname);
+        errors = verifyImd(imdName, &good);
+    }
+    double mb = fluxBytes / 1e6;
+    printf("%-12s %-4s %6d %8.1f %8.1f %8.0f %8.1f %8.0f %8.1f %8.0f  %d/%d%s\n", fmt->name, ext + 1,
+           tracks, mb, rate(mb, seconds(gen) * iterations), rate(mb, seconds(ingest)),
+           rate(tracks, seconds(ingest)), rate(mb, seconds(decode)), rate(tracks, seconds(decode)),
+           rate(mb, seconds(write)), good, cylinders * sides * fmt->spt, errors ? " MISMATCH" : "");
+    remove(fname);
+    remove(imdName);
+    remove(logName);
+}
+
+/*
+ * the stages are timed by wall clock with the read ahead off, so that loading a track
+ * is not overlapped with decoding the previous one
+ */
+static void bench() {
+    if (!cylinders)
+        cylinders = 20;
+    setReadAhead(0, 0);
+    printf("Tracks per format %d, jitter %s, drift %.1f%%, missing %d, weak %d, iterations %d\n",
+           cylinders * sides, jitter < 0 ? "3%" : "user", drift, cntMissing, cntWeak, iterations);
+    printf("%-12s %-4s %6s %8s %8s %8s %8s %8s %8s %8s  %s\n", "", "", "", "Flux", "Generate", "Ingest", "",
+           "Decode", "", "IMD", "Sectors");
+    printf("%-12s %-4s %6s %8s %8s %8s %8s %8s %8s %8s  %s\n", "Format", "Type", "Tracks", "MB", "MB/s", "MB/s",
+           "trk/s", "MB/s", "trk/s", "MB/s", "ok/total");
+
+    double userJitter = jitter;
+    for (fmt = formatInfo; fmt->name; fmt++) {
+        if (!fmt->description || strstr(fmt->description, "**") || !isSupported(fmt))
+            continue;
+        family    = fmt->encoding == E_M2FM8 ? G_M2FM : (fmt->encoding == E_FM5 || fmt->encoding == E_FM8) ? G_FM : G_MFM;
+        jitter    = userJitter >= 0 ? userJitter : fmt->nominalCellSize * 0.03;
+        benchFormat(".zip");
+        benchFormat(".scp");
+    }
+}
+
+static int intArg(const char *arg, int low, int high) {
+    char *s;
+    long val = strtol(arg, &s, 10);
+    if (*s || val < low || val > high)
+        usage("Invalid value '%s' for -%c option, range is %d-%d", arg, optopt, low, high);
+    return (int)val;
+}
+
+static double floatArg(const char *arg, double low, double high) {
+    char *s;
+    double val = strtod(arg, &s);
+    if (*s || val < low || val > high)
+        usage("Invalid value '%s' for -%c option", arg, optopt);
+    return val;
+}
+
+int main(int argc, char **argv) {
+    bool benchMode      = false;
+    const char *fmtName = "MFM5-16x256";
+
+    createLogFile(NULL);
+    while (getopt(argc, argv, "bc:d:f:j:m:n:p:r:s:t:w:x:") != EOF) {
+        switch (optopt) {
+        case 'b': benchMode = true; break;
+        case 'c': cylinders = intArg(optarg, 1, MAXCYLINDER); break;
+        case 'd': drift = floatArg(optarg, 0.0, 10.0); break;
+        case 'f':
+            fmtName = optarg;
+            if (stricmp(fmtName, "help") == 0)
+                listFormats();
+            break;
+        case 'j': jitter = floatArg(optarg, 0.0, 2000.0); break;
+        case 'm': cntMissing = intArg(optarg, 0, MAXDEFECTS); break;
+        case 'n': iterations = intArg(optarg, 1, 1000); break;
+        case 'p': speedError = floatArg(optarg, -25.0, 25.0); break;
+        case 'r': revs = intArg(optarg, 1, MAXREVS); break;
+        case 's': sides = intArg(optarg, 1, 2); break;
+        case 't': slew = floatArg(optarg, -5.0, 5.0); break;
+        case 'w': cntWeak = intArg(optarg, 0, MAXDEFECTS); break;
+        case 'x': seed = (uint32_t)intArg(optarg, 0, INT32_MAX); break;
+        default: usage("invalid option -%c", optopt);
+        }
+    }
+    if (benchMode) {
+        if (optind != argc)
+            usage("-b does not take a file name");
+        bench();
+        return 0;
+    }
+    if (optind != argc - 1)
+        usage("Expected a single output file");
+
+    for (fmt = formatInfo; fmt->name && stricmp(fmt->name, fmtName) != 0; fmt++)
+        ;
+    if (!fmt->name || !isSupported(fmt))
+        usage("Format %s is not supported, use -f help for the list", fmtName);
+    family = fmt->encoding == E_M2FM8 ? G_M2FM : (fmt->encoding == E_FM5 || fmt->encoding == E_FM8) ? G_FM : G_MFM;
+    if (!cylinders)
+        cylinders = is8Inch() ? 77 : 40;
+    if (jitter < 0)
+        jitter = 0;
+    if (cntMissing + cntWeak > cylinders * sides * fmt->spt)
+        usage("Too many missing / weak sectors requested");
+
+    if (!generate(argv[optind]))
+        fatal("Cannot create %s\n", argv[optind]);
+    return 0;
+}
@@ -0,0 +1,335 @@
+/****************************************************************************
+ *  program: flux2imd - create imd image file from kryoflux file            *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+    compact indexed flux container (.flx)
+    holds the flux streams of a disk as loaded from a kryoflux zip, directory of .raw files
+    or scp file, so the disk can be decoded again without inflating or parsing the original.
+    Each track holds the calls that built its flux stream, so loading a track replays them
+    and gives exactly the same sample times as the original file.
+
+    all values are little endian
+    header      "F2IFLUX" 0x1a, uint32 version, uint32 directory entries (MAXCYLINDER * 2)
+    directory   for each cylinder and head, uint32 offset and uint32 length of the track, 0 if none
+    track       int16 cylinder, int16 head, int16 hard sector count, uint32 event count,
+                uint32 sample count and index count as passed to beginFlux, uint32 delta count, uint32 bias,
+                double sample clock, index clock, nominal rpm
+                events, per entry uint32 delta count before the event, int16 index type or FLUXRPM,
+                uint32 index delta, double rpm
+                deltas, each sample clock delta less the bias as a varint, 7 bits per byte, low bits first.
+                The bias is the smallest delta in the track
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "flux2imd.h"
+#include "flx.h"
+#include "readahead.h"
+#include "stats.h"
+#include "stdflux.h"
+#include "trackManager.h"
+#include "util.h"
+
+#define FLXMAGIC    "F2IFLUX\x1a"
+#define FLXVERSION  1
+#define HDRSIZE     16
+#define DIRENTRIES  (MAXCYLINDER * 2)
+#define TRKHDRSIZE  (6 + 5 * 4 + 3 * 8)
+#define EVENTSIZE   18
+
+bool isSampledCyl(int cylinder);      // container.c
+void expectTrack(int track);          // container.c
+
+static uint32_t flxDir[DIRENTRIES][2];      // offset and length of each track
+static FILE *flxFp;
+static const char *flxFname;
+static int flxNext;                         // next directory entry to fetch
+
+// a growable buffer used to build a track and to hold its decoded samples
+static uint8_t *trkBuf;
+static size_t trkSize;
+static size_t trkLen;
+
+static uint8_t *reserve(size_t len) {
+    if (trkLen + len > trkSize) {
+        size_t newSize = trkSize ? trkSize * 2 : 64 * 1024;
+        while (trkLen + len > newSize)
+            newSize *= 2;
+        uint8_t *newBuf = (uint8_t *)xmalloc(newSize);
+        if (trkBuf) {
+            memcpy(newBuf, trkBuf, trkLen);
+            free(trkBuf);
+        }
+        trkBuf  = newBuf;
+        trkSize = newSize;
+    }
+    return trkBuf + trkLen;
+}
+
+static void put16(uint16_t val) {
+    uint8_t *p = reserve(2);
+    p[0]       = (uint8_t)val;
+    p[1]       = (uint8_t)(val >> 8);
+    trkLen += 2;
+}
+
+static void put32(uint32_t val) {
+    uint8_t *p = reserve(4);
+    for (int i = 0; i < 4; i++, val >>= 8)
+        p[i] = (uint8_t)val;
+    trkLen += 4;
+}
+
+static void putDouble(double val) {
+    uint64_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    put32((uint32_t)bits);
+    put32((uint32_t)(bits >> 32));
+}
+
+static void putVarint(uint32_t val) {
+    uint8_t *p = reserve(5);
+    uint8_t *s = p;
+    while (val >= 0x80) {
+        *s++ = (uint8_t)(val | 0x80);
+        val >>= 7;
+    }
+    *s++ = (uint8_t)val;
+    trkLen += s - p;
+}
+
+static uint16_t get16(const uint8_t *p) {
+    return p[0] + (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return p[0] + (p[1] << 8) + (p[2] << 16) + ((uint32_t)p[3] << 24);
+}
+
+static double getDouble(const uint8_t *p) {
+    uint64_t bits = get32(p) + ((uint64_t)get32(p + 4) << 32);
+    double val;
+    memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+bool flxCreate(const char *fname) {
+    memset(flxDir, 0, sizeof(flxDir));
+    if ((flxFp = fopen(fname, "wb")) == NULL) {
+        logFull(D_ERROR, "cannot create %s\n", fname);
+        return false;
+    }
+    flxFname = fname;
+    trkLen   = 0;                      // header and directory are written by flxFinish
+    memset(reserve(HDRSIZE + DIRENTRIES * 8), 0, HDRSIZE + DIRENTRIES * 8);
+    trkLen = HDRSIZE + DIRENTRIES * 8;
+    if (fwrite(trkBuf, 1, trkLen, flxFp) != trkLen) {
+        logFull(D_ERROR, "cannot write %s\n", fname);
+        fclose(flxFp);
+        flxFp = NULL;
+        return false;
+    }
+    return true;
+}
+
+// add the currently loaded flux stream, a track loaded again replaces the earlier one
+bool flxAddTrack() {
+    int cyl  = getCyl();
+    int head = getHead();
+    if (cyl < 0 || cyl >= MAXCYLINDER || head < 0 || head > 1) {
+        logFull(D_WARNING, "Unknown cylinder / head, track not saved\n");
+        return true;
+    }
+    const fluxRecord_t *rec = getFluxRecord();
+
+    uint32_t bias = UINT32_MAX;
+    for (uint32_t i = 0; i < rec->deltaCnt; i++)
+        if (rec->deltas[i] < bias)
+            bias = rec->deltas[i];
+    if (rec->deltaCnt == 0)
+        bias = 0;
+
+    trkLen = 0;
+    put16((uint16_t)cyl);
+    put16((uint16_t)head);
+    put16(rec->hsCnt);
+    put32(rec->eventCnt);
+    put32(rec->sampleCnt);
+    put32(rec->indexCnt);
+    put32(rec->deltaCnt);
+    put32(bias);
+    putDouble(rec->sclk);
+    putDouble(getIndexClock());
+    putDouble(rec->rpm);
+    for (int i = 0; i < rec->eventCnt; i++) {
+        put32(rec->events[i].pos);
+        put16((uint16_t)rec->events[i].itype);
+        put32(rec->events[i].delta);
+        putDouble(rec->events[i].rpm);
+    }
+    for (uint32_t i = 0; i < rec->deltaCnt; i++)
+        putVarint(rec->deltas[i] - bias);
+
+    long offset = ftell(flxFp);
+    if (offset < 0 || fwrite(trkBuf, 1, trkLen, flxFp) != trkLen) {
+        logFull(D_ERROR, "cannot write %s\n", flxFname);
+        return false;
+    }
+    flxDir[cyl * 2 + head][0] = (uint32_t)offset;
+    flxDir[cyl * 2 + head][1] = (uint32_t)trkLen;
+    return true;
+}
+
+// write the header and directory, the file is removed if no tracks were saved
+bool flxFinish() {
+    bool hasTracks = false;
+    for (int i = 0; i < DIRENTRIES; i++)
+        if (flxDir[i][0])
+            hasTracks = true;
+
+    trkLen = 0;
+    memcpy(reserve(8), FLXMAGIC, 8);
+    trkLen = 8;
+    put32(FLXVERSION);
+    put32(DIRENTRIES);
+    for (int i = 0; i < DIRENTRIES; i++) {
+        put32(flxDir[i][0]);
+        put32(flxDir[i][1]);
+    }
+    bool ok = hasTracks && fseek(flxFp, 0, SEEK_SET) == 0 && fwrite(trkBuf, 1, trkLen, flxFp) == trkLen;
+    ok = fclose(flxFp) == 0 && ok;
+    flxFp = NULL;
+    if (!ok) {
+        logFull(D_ERROR, hasTracks ? "cannot write %s\n" : "no tracks to save in %s\n", flxFname);
+        remove(flxFname);
+    }
+    return ok;
+}
+
+
+bool flxOpen(const char *fname) {
+    uint8_t hdr[HDRSIZE + DIRENTRIES * 8];
+
+    if ((flxFp = fopen(fname, "rb")) == NULL) {
+        logFull(D_WARNING, "cannot open file\n");
+        return false;
+    }
+    if (fread(hdr, 1, sizeof(hdr), flxFp) != sizeof(hdr) || memcmp(hdr, FLXMAGIC, 8) != 0 ||
+        get32(hdr + 8) != FLXVERSION || get32(hdr + 12) != DIRENTRIES) {
+        fclose(flxFp);
+        flxFp = NULL;
+        logFull(D_WARNING, "file is not valid\n");
+        return false;
+    }
+    for (int i = 0; i < DIRENTRIES; i++) {
+        flxDir[i][0] = get32(hdr + HDRSIZE + i * 8);
+        flxDir[i][1] = get32(hdr + HDRSIZE + i * 8 + 4);
+        if (flxDir[i][0] && isSampledCyl(i / 2))
+            expectTrack(i);             // tracks flxFetch will return
+    }
+    flxFname = fname;
+    flxNext  = 0;
+    createLogFile(fname);
+    return true;
+}
+
+// read the next track, called from the read ahead thread
+bool flxFetch(fluxImage_t *image) {
+    while (flxNext < DIRENTRIES) {
+        int trk = flxNext++;
+        if (!flxDir[trk][0] || !isSampledCyl(trk / 2))
+            continue;
+        image->track  = trk;
+        image->status = IMG_ERROR;
+        image->data   = (uint8_t *)xmalloc(flxDir[trk][1] ? flxDir[trk][1] : 1);
+        image->size   = flxDir[trk][1];
+        if (fseek(flxFp, flxDir[trk][0], SEEK_SET) == 0 && fread(image->data, 1, image->size, flxFp) == image->size)
+            image->status = IMG_OK;
+        return true;
+    }
+    return false;
+}
+
+bool flxLoad(fluxImage_t *image) {
+    char ct[24];
+    const uint8_t *p = image->data;
+
+    sprintf(ct, "%d,%d", image->track / 2, image->track % 2);
+    setLogPrefix(flxFname, ct);
+    if (image->status != IMG_OK || image->size < TRKHDRSIZE) {
+        logFull(D_WARNING, "Track load error\n");
+        return false;
+    }
+    uint32_t eventCnt  = get32(p + 6);
+    uint32_t deltaCnt  = get32(p + 18);
+    uint32_t bias      = get32(p + 22);
+    const uint8_t *s   = p + TRKHDRSIZE + eventCnt * EVENTSIZE;
+    const uint8_t *end = p + image->size;
+    if (eventCnt > image->size || s > end || deltaCnt > (uint32_t)(end - s)) {      // each delta takes at least one byte
+        logFull(D_WARNING, "Track load error\n");
+        return false;
+    }
+
+    beginFlux(get32(p + 10), (int)get32(p + 14), getDouble(p + 26), getDouble(p + 42), (int16_t)get16(p + 4));
+    setIndexClock(getDouble(p + 34));
+    const uint8_t *event = p + TRKHDRSIZE;
+    uint32_t i;
+    for (i = 0; i <= deltaCnt; i++) {
+        for (; eventCnt && get32(event) == i; eventCnt--, event += EVENTSIZE) {
+            int16_t itype = (int16_t)get16(event + 4);
+            if (itype == FLUXRPM)
+                setActualRPM(getDouble(event + 10));
+            else
+                addIndex(itype, get32(event + 6));
+        }
+        if (i == deltaCnt)
+            break;
+        uint32_t delta = 0;
+        for (int shift = 0; s < end && shift < 32; shift += 7) {
+            delta |= (uint32_t)(*s & 0x7f) << shift;
+            if (!(*s++ & 0x80))
+                break;
+        }
+        addDelta(delta + bias);
+    }
+    endFlux();
+    if (i != deltaCnt || eventCnt || s != end) {
+        logFull(D_WARNING, "Track load error\n");
+        return false;
+    }
+    stats.bytes += image->size;
+    setCylHead((int16_t)get16(p), (int16_t)get16(p + 2));
+    return true;
+}
+
+bool flxClose() {
+    if (flxFp)
+        fclose(flxFp);
+    flxFp = NULL;
+    return true;
+}
@@ -25,12 +25,15 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <string.h>
 #include "sectorManager.h"
 #include "dpll.h"
 #include "formats.h"
 #include "flux.h"
 #include "util.h"
 #include "stdflux.h"
+#include "stats.h"
+#include "trace.h"
 
 // initial patterns for DD disks
 
@@ -255,6 +258,11 @@ char *precannedFormats[][2] = {
 };
 
 
+// formats loaded by loadFormats, these follow the built in ones
+static formatInfo_t *userFormats;
+static int cntUserFormats;
+
+
 void showFormats() {
     printf("Current user specified single formats are\n");
     printf("    %-12s  Description\n", "Format");
@@ -262,6 +270,12 @@ void showFormats() {
         if (*formatInfo[i].name != -128 && formatInfo[i].description)
             printf("    %-12s  %s\n", formatInfo[i].name, formatInfo[i].description);
     printf("Note ** formats will auto adapt based on detected sectors / encoding\n\n");
+    if (cntUserFormats) {
+        printf("Formats loaded from files\n");
+        for (int i = 0; i < cntUserFormats; i++)
+            printf("    %-12s  %s\n", userFormats[i].name, userFormats[i].description);
+        putchar('\n');
+    }
     printf("Current predefined multi formats are\n");
     for (int i = 0; precannedFormats[i][0]; i++)
         printf("    %-12s %s\n", precannedFormats[i][0], precannedFormats[i][1]);
@@ -293,17 +307,23 @@ static bool crcLSI(uint16_t* data, int len) {
 
 }
 
-static bool crcZDS(uint16_t* data, int len) {
 #define CRC16 0x8005
+#define CCITT 0x1021
+
+static uint16_t zdsResidue(uint16_t *data, int len) {
     uint16_t crc = curFormat->crcInit;
     len -= 2;               // exclude postamble
     for (int i = 0; i < len; i++)
         for (uint16_t mask = 0x80; mask; mask >>= 1)
             crc = ((crc << 1) | ((data[i] & mask) ? 1 : 0)) ^ ((crc & 0x8000) ? CRC16 : 0);
-    return crc == 0;
+    return crc;
 }
 
-static bool crcRev(uint16_t* data, int len) {
+static bool crcZDS(uint16_t* data, int len) {
+    return zdsResidue(data, len) == 0;
+}
+
+static uint16_t revResidue(uint16_t *data, int len) {
     uint8_t x;
     uint16_t crc = curFormat->crcInit;
 
@@ -312,7 +332,11 @@ static bool crcRev(uint16_t* data, int len) {
         x ^= x >> 4;
         crc = (crc << 8) ^ (x << 12) ^ (x << 5) ^ x;
     }
-    return crc == 0;
+    return crc;
+}
+
+static bool crcRev(uint16_t* data, int len) {
+    return revResidue(data, len) == 0;
 }
 
 bool crcNSI(uint16_t *data, int len) {
@@ -333,7 +357,7 @@ bool crc8(uint16_t* data, int len) {
     return (crc & 0xff) == (data[len - 1] & 0xff);
 }
 
-static bool crcStd(uint16_t* buf, int len) {
+static uint16_t stdResidue(uint16_t *buf, int len) {
     uint8_t x;
     uint16_t crc = curFormat->crcInit;
 
@@ -342,18 +366,252 @@ static bool crcStd(uint16_t* buf, int len) {
         x ^= x >> 4;
         crc = (crc << 8) ^ (x << 12) ^ (x << 5) ^ x;
     }
-    return crc == 0;
+    return crc;
+}
+
+static bool crcStd(uint16_t* buf, int len) {
+    return stdResidue(buf, len) == 0;
 }
 
-static formatInfo_t *lookupFormat(const char* fmtName) {
+/*
+ * CRC error correction
+ * As the CRCs are linear, the residue left by a corrupt sector is the residue of the error
+ * pattern alone, which for a single bit error depends only on its distance from the end of
+ * the data. Tables mapping a residue to the distance of a single bit error or of an adjacent
+ * two bit error, make finding the error a simple lookup.
+ * Both polynomials have (x + 1) as a factor, so single bit errors always leave an odd parity
+ * residue and double bit errors an even one, hence the two tables cannot give conflicting answers.
+ */
+#define MAXFIXBITS      ((1024 + 16) * 8)
+#define MAXFIXSUSPECT   4
+
+static uint16_t singleBit[0x10000];     // residue -> distance of bit from end + 1
+static uint16_t doubleBit[0x10000];     // residue -> distance of the later bit from end + 1
+static uint16_t tableSeed;              // residue of the last bit, identifies the current tables
+
+static void buildFixTables(uint16_t seed, uint16_t poly) {
+    if (tableSeed == seed)
+        return;
+    memset(singleBit, 0, sizeof(singleBit));
+    memset(doubleBit, 0, sizeof(doubleBit));
+    uint16_t residue = seed;
+    for (uint16_t dist = 1; dist <= MAXFIXBITS; dist++) {
+        uint16_t next = (residue << 1) ^ ((residue & 0x8000) ? poly : 0);
+        singleBit[residue] = dist;
+        doubleBit[residue ^ next] = dist;
+        residue = next;
+    }
+    tableSeed = seed;
+}
+
+/*
+ * attempt to correct a single bit or adjacent two bit error in data
+ * the first skip bytes are known values, e.g. the address mark, so cannot be in error
+ * to limit the risk of miscorrecting a badly damaged sector, only data with a few bytes the
+ * decoder marked as suspect is considered and the error must touch one of them. Without a
+ * suspect byte about 1 in 16 residues of a 512 byte sector look like a single bit error
+ * returns the number of bits corrected, 0 if not correctable
+ */
+int crcCorrect(uint16_t *data, int len, int skip) {
+    uint16_t residue;
+    bool reversed = false;
+
+    if (curFormat->crcFunc == crcStd) {
+        buildFixTables(CCITT, CCITT);   // crcStd works on the unaugmented message
+        residue = stdResidue(data, len);
+    } else if (curFormat->crcFunc == crcRev) {
+        buildFixTables(CCITT, CCITT);
+        residue  = revResidue(data, len);
+        reversed = true;
+    } else if (curFormat->crcFunc == crcZDS) {
+        buildFixTables(1, CRC16);
+        residue = zdsResidue(data, len);
+        len -= 2;                       // postamble is not covered by the crc
+    } else
+        return 0;
+    if (residue == 0 || len * 8 > MAXFIXBITS)
+        return 0;
+
+    int cntSuspect = 0;
+    for (int i = skip; i < len; i++)
+        if (data[i] & SUSPECT)
+            cntSuspect++;
+    if (cntSuspect == 0 || cntSuspect > MAXFIXSUSPECT)
+        return 0;
+
+    int bits = 1;
+    int dist = singleBit[residue];
+    if (!dist) {
+        bits = 2;
+        dist = doubleBit[residue];
+    }
+    if (!dist || dist + bits - 1 > (len - skip) * 8)
+        return 0;
+
+    int pos[2];
+    bool touchesSuspect = false;
+    for (int i = 0; i < bits; i++) {
+        int d = dist - 1 + i;
+        pos[i] = len - 1 - d / 8;
+        if (data[pos[i]] & SUSPECT)
+            touchesSuspect = true;
+    }
+    if (!touchesSuspect)
+        return 0;
+    for (int i = 0; i < bits; i++) {
+        int d = dist - 1 + i;
+        data[pos[i]] ^= reversed ? 0x80 >> (d % 8) : 1 << (d % 8);
+    }
+    return bits;
+}
+
+formatInfo_t *lookupFormat(const char* fmtName) {
     formatInfo_t* p;
     for (p = formatInfo; p->name; p++) {
         if (stricmp(p->name, fmtName) == 0)
             return p;
     }
+    for (int i = 0; i < cntUserFormats; i++)
+        if (stricmp(userFormats[i].name, fmtName) == 0)
+            return &userFormats[i];
     return NULL;
 }
 
+/*
+    format definition files
+    each line defines a format, derived from a built in one that supplies the encoding,
+    address mark patterns and special handling, with any of its geometry overridden
+        name base [size=n] [first=n] [spt=n] [crc=std|rev|zds|lsi|nsi|sum8] [crcinit=n]
+                  [idam=n] [data=n] [spacing=n] [cell=ns] [profiles=order] [uinv] [desc=text]
+    desc takes the rest of the line. Blank lines and lines starting # are ignored.
+    Loaded formats can only be selected with -f, they are not used in auto detection
+*/
+static struct {
+    char *name;
+    bool (*crcFunc)(uint16_t *data, int len);
+} const crcNames[] = {
+    { "std", crcStd }, { "rev", crcRev }, { "zds", crcZDS }, { "lsi", crcLSI }, { "nsi", crcNSI }, { "sum8", crc8 }
+};
+
+static char *fmtString(const char *s) {
+    return strcpy((char *)xmalloc(strlen(s) + 1), s);
+}
+
+static long fmtValue(const char *fname, int lineNo, const char *key, const char *val, long min, long max) {
+    char *endPtr;
+    long n = strtol(val, &endPtr, 0);
+    if (endPtr == val || *endPtr || n < min || n > max)
+        logFull(D_FATAL, "%s(%d): invalid %s=%s\n", fname, lineNo, key, val);
+    return n;
+}
+
+void loadFormats(const char *fname) {
+    char line[512];
+    FILE *fp;
+    int lineNo = 0;
+
+    if (!(fp = fopen(fname, "rt")))
+        logFull(D_FATAL, "Cannot open format file %s\n", fname);
+    while (fgets(line, sizeof(line), fp)) {
+        lineNo++;
+        char *desc = strstr(line, "desc=");
+        if (desc) {
+            *desc = '\0';
+            desc += 5;
+            desc[strcspn(desc, "\r\n")] = '\0';
+        }
+        char *name = strtok(line, " \t\r\n");
+        if (!name || *name == '#')
+            continue;
+        char *baseName = strtok(NULL, " \t\r\n");
+        formatInfo_t *base = NULL;
+        if (lookupFormat(name))
+            logFull(D_FATAL, "%s(%d): format %s is already defined\n", fname, lineNo, name);
+        if (!baseName || !(base = lookupFormat(baseName)) || *base->name == -128)
+            logFull(D_FATAL, "%s(%d): unknown base format %s\n", fname, lineNo, baseName ? baseName : "");
+
+        formatInfo_t fmt = *base;
+        fmt.name         = fmtString(name);
+        fmt.options &= ~(O_SIZE | O_SPC);   // the trial format groups rely on table order
+        fmt.description = desc ? fmtString(desc) : "";
+        for (char *key; (key = strtok(NULL, " \t\r\n"));) {
+            char *val = strchr(key, '=');
+            if (val)
+                *val++ = '\0';
+            if (strcmp(key, "uinv") == 0 && !val)
+                fmt.options |= O_UINV;
+            else if (!val)
+                logFull(D_FATAL, "%s(%d): %s needs a value\n", fname, lineNo, key);
+            else if (strcmp(key, "size") == 0) {
+                long size = fmtValue(fname, lineNo, key, val, 128, 1024);
+                for (fmt.sSize = 0; (128 << fmt.sSize) < size; fmt.sSize++)
+                    ;
+                if ((128 << fmt.sSize) != size)
+                    logFull(D_FATAL, "%s(%d): sector size %s is not a power of 2\n", fname, lineNo, val);
+            } else if (strcmp(key, "first") == 0)
+                fmt.firstSectorId = fmtValue(fname, lineNo, key, val, 0, 255);
+            else if (strcmp(key, "spt") == 0)
+                fmt.spt = fmtValue(fname, lineNo, key, val, 1, MAXSECTOR);
+            else if (strcmp(key, "crcinit") == 0)
+                fmt.crcInit = (uint16_t)fmtValue(fname, lineNo, key, val, 0, 0xffff);
+            else if (strcmp(key, "idam") == 0)
+                fmt.firstIDAM = fmtValue(fname, lineNo, key, val, 0, 0xffff);
+            else if (strcmp(key, "data") == 0)
+                fmt.firstDATA = fmtValue(fname, lineNo, key, val, 0, 0xffff);
+            else if (strcmp(key, "spacing") == 0)
+                fmt.spacing = fmtValue(fname, lineNo, key, val, 1, 0xffff);
+            else if (strcmp(key, "cell") == 0)
+                fmt.nominalCellSize = fmtValue(fname, lineNo, key, val, 100, 10000);
+            else if (strcmp(key, "profiles") == 0) {
+                if (strspn(val, "01234") != strlen(val) || !*val)
+                    logFull(D_FATAL, "%s(%d): invalid profiles=%s\n", fname, lineNo, val);
+                fmt.profileOrder = fmtString(val);
+            } else if (strcmp(key, "crc") == 0) {
+                unsigned i;
+                for (i = 0; i < sizeof(crcNames) / sizeof(crcNames[0]) && strcmp(crcNames[i].name, val) != 0; i++)
+                    ;
+                if (i == sizeof(crcNames) / sizeof(crcNames[0]))
+                    logFull(D_FATAL, "%s(%d): unknown crc=%s\n", fname, lineNo, val);
+                fmt.crcFunc = crcNames[i].crcFunc;
+            } else
+                logFull(D_FATAL, "%s(%d): unknown setting %s\n", fname, lineNo, key);
+        }
+        formatInfo_t *newFormats = (formatInfo_t *)xmalloc((cntUserFormats + 1) * sizeof(formatInfo_t));
+        if (userFormats) {
+            memcpy(newFormats, userFormats, cntUserFormats * sizeof(formatInfo_t));
+            free(userFormats);
+        }
+        userFormats                   = newFormats;
+        userFormats[cntUserFormats++] = fmt;
+    }
+    fclose(fp);
+}
+
+// hash of a loaded format's definition, so decodes cached with an older definition are not
+// reused. Built in formats return 0 as the version in the cache key covers them
+uint64_t formatHash(const char *fmtName) {
+    formatInfo_t *fmt = NULL;
+    for (int i = 0; fmtName && i < cntUserFormats; i++)
+        if (stricmp(userFormats[i].name, fmtName) == 0)
+            fmt = &userFormats[i];
+    if (!fmt)
+        return 0;
+
+    int base, crc;          // the pattern table and crc are identified by index, not address
+    for (base = 0; formatInfo[base].name && formatInfo[base].patterns != fmt->patterns; base++)
+        ;
+    for (crc = 0; crc < (int)(sizeof(crcNames) / sizeof(crcNames[0])) && crcNames[crc].crcFunc != fmt->crcFunc; crc++)
+        ;
+    char def[256];
+    snprintf(def, sizeof(def), "%s|%u|%d|%d|%d|%x|%d|%d|%x|%d|%d|%d|%u|%s", fmt->name, fmt->sSize,
+             fmt->firstSectorId, fmt->spt, fmt->encoding, fmt->options, base, crc, fmt->crcInit, fmt->firstIDAM,
+             fmt->firstDATA, fmt->spacing, fmt->nominalCellSize, fmt->profileOrder ? fmt->profileOrder : "");
+    uint64_t hash = 0xcbf29ce484222325;         // FNV-1a
+    for (char *t = def; *t; t++)
+        hash = (hash ^ (uint8_t)*t) * 0x100000001b3;
+    return hash;
+}
+
 static char *probe() {
     int matchType;
     int firstMatch = 0;     // 1 MFM or FM, 2 M2FM, 3 Intel M2FM, 4 HP M2FM, 5 TI
@@ -457,16 +715,19 @@ static char *probe() {
         1110    01110 
         1111    01111 
 */
+// mask of the bits that suppress a clock bit, before the clock bit position
+static unsigned clockMask(int encoding) {
+    switch (encoding) {
+    case E_MFM5: case E_MFM8: case E_MFM5H: return 5;
+    case E_M2FM8: return 0xd;
+    default: return 0;
+    }
+}
+
 // prevPattern is used for MFM & M2FM encoding specifically that last dbit (MFM & M2FM) and last cbit (M2FM)
 uint64_t encode(uint32_t val, uint32_t prevPattern) {
     uint64_t pattern = prevPattern;
-    unsigned mask;           // mask for determining if cbit needed
-
-    switch (curFormat->encoding) {
-    case E_MFM5: case E_MFM8: case E_MFM5H: mask = 5; break;
-    case E_M2FM8: mask = 0xd; break;
-    default: mask = 0; break;
-    }
+    unsigned mask = clockMask(curFormat->encoding);     // mask for determining if cbit needed
 
     for (uint32_t i = 0x80000000; i; i >>= 1) {
         pattern <<= 2;
@@ -479,28 +740,55 @@ uint64_t encode(uint32_t val, uint32_t prevPattern) {
 }
 
 
+/*
+ * the byte decode is done by two table lookups, each covering four data bits and the clock
+ * bits needed to check them. The tables are built by selectFormat for the format's encoding
+ * with any bit reversal and inversion folded in, so decode has no per byte option tests
+ */
+static uint16_t loDecode[0x400];    // pattern bits 0-9 -> data bits 0-3 + SUSPECT
+static uint16_t hiDecode[0x400];    // pattern bits 8-17 -> data bits 4-7 + SUSPECT
+static unsigned decodeKey = ~0u;    // encoding mask and options the tables were built for
+
+static void buildDecodeTables(formatInfo_t const *fmt) {
+    unsigned mask = clockMask(fmt->encoding);
+    unsigned key  = (mask << 16) | (fmt->options & (O_REV | O_INV));
+    if (key == decodeKey)
+        return;
+    unsigned loBits = (fmt->options & O_REV) ? flip[0x0f] : 0x0f;
+    for (unsigned bits = 0; bits < 0x400; bits++) {
+        unsigned val = 0;
+        bool suspect = false;
+        unsigned p   = bits;
+        for (int i = 0; i < 4; i++, p >>= 2) {
+            val |= (p & 1) << i;
+            suspect |= ((p & 2) == 2) ^ ((p & mask) == 0);
+        }
+        unsigned lo = val, hi = val << 4;
+        if (fmt->options & O_REV) {
+            lo = flip[lo];
+            hi = flip[hi];
+        }
+        if (fmt->options & O_INV) {
+            lo ^= loBits;
+            hi ^= loBits ^ 0xff;
+        }
+        loDecode[bits] = lo + (suspect ? SUSPECT : 0);
+        hiDecode[bits] = hi + (suspect ? SUSPECT : 0);
+    }
+    decodeKey = key;
+}
+
+// make fmt the current format, all changes of format go through here
+void selectFormat(formatInfo_t *fmt) {
+    curFormat = fmt;
+    if (fmt)
+        buildDecodeTables(fmt);
+}
+
 // decode lower 16 bits of pattern into data byte + flag to indicate if suspect encoding
 // note for MFM & M2FM bits 17, 18 will are used to determine if suspect
 int decode(uint64_t pattern) {
-    unsigned mask;
-    int val = 0;
-    bool suspect = false;
-
-    switch (curFormat->encoding) {
-    case E_MFM5: case E_MFM8: case E_MFM5H: mask = 5; break;
-    case E_M2FM8: mask = 0xd; break;
-    default: mask = 0; break;
-    }
-    for (int i = 0; i < 8; i++, pattern >>= 2) {
-        val = (val >> 1) + ((pattern & 1) ? 0x80 : 0);
-        suspect |= ((pattern & 2) == 2) ^ ((pattern & mask) == 0);
-    }
-    if (curFormat->options & O_REV)
-        val = flip[val];
-    if (curFormat->options & O_INV)
-        val ^= 0xff;
-
-    return val + (suspect ? SUSPECT : 0);
+    return loDecode[pattern & 0x3ff] | hiDecode[(pattern >> 8) & 0x3ff];
 }
 
 
@@ -583,34 +871,51 @@ bool chkPattern(uint64_t mask) {
 
 }
 
-int matchPattern(int searchLimit) {
+/*
+    the matcher is built in two variants, the untraced one is used for normal decodes so
+    they pay nothing for tracing. The traced one records either every bit position tested
+    or just the address marks found, depending on traceLevel
+*/
+static inline int matchKernel(int searchLimit, bool traced) {
     pattern_t* p;
     int addedBits = 0;
     // scale searchLimit to bits to check 
     for (searchLimit *= 16; searchLimit > 0 && getBit() >= 0; searchLimit--) {
         // speed optimisation, don't consider pattern until at least a byte seen (16 data/clock)
         if (++addedBits >= 16) {
-            if (debug & D_PATTERN)              // avoid costly processing unless necessary
-                logBasic("%6u: %s %016llX %s\n", getBitCnt(0), bin64Str(pattern), pattern, decodePattern64());
+            stats.patternTests++;
             // see if we have a pattern match
-            for (p = curFormat->patterns; p->mask; p++) {
-                if (((pattern ^ p->match) & p->mask) == 0 && chkPattern(p->mask)) {
-                        if (debug & D_ADDRESSMARK)      // avoid costly processing unless necessary
-                            logBasic("%u: %016llX %016llX %016llX %s %s\n", getBitCnt(0), pattern,
-                                p->match, p->mask, decodePattern64(), getName(p->am));
-                        return p->am; 
-                }
-            }
+            for (p = curFormat->patterns; p->mask; p++)
+                if (((pattern ^ p->match) & p->mask) == 0 && chkPattern(p->mask))
+                    break;
+            if (traced && (p->mask || traceLevel == TRACE_ALL))
+                traceBit(p->mask ? p->am : 0);
+            if (p->mask)
+                return p->am;
         }
     }
     return 0;
 }
 
+static int matchUntraced(int searchLimit) {
+    return matchKernel(searchLimit, false);
+}
 
+static int matchTraced(int searchLimit) {
+    return matchKernel(searchLimit, true);
+}
 
-int matchPattern2(bool lock) {
+int matchPattern(int searchLimit) {
+    return traceLevel ? matchTraced(searchLimit) : matchUntraced(searchLimit);
+}
+
+
+
+// matchPattern2 is split the same way as matchPattern, both variants share the last match
+static pattern_t *pMatch;
+
+static inline int match2Kernel(bool lock, bool traced) {
     pattern_t *p;
-    static pattern_t *pMatch = 0;
 
     bool chkMatch = pattern && pMatch == NULL;
 
@@ -618,17 +923,15 @@ int matchPattern2(bool lock) {
 
     for (i = 0; i < 16 && getBit() >= 0; i++) {
         if (!lock && (chkMatch || i == 15)) {
-            if (debug & D_PATTERN)              // avoid costly processing unless necessary
-                logBasic("%6u: %s %016llX %s\n", getBitCnt(0), bin64Str(pattern), pattern, decodePattern64());
             // see if we have a pattern match
-            for (p = curFormat->patterns; p->mask; p++) {
-                if (((pattern ^ p->match) & p->mask) == 0) {
-                    if (debug & D_ADDRESSMARK)      // avoid costly processing unless necessary
-                        logBasic("%u(%d): %016llX %016llX %016llX %s %s\n", getBitCnt(0), i + 1, pattern,
-                                 p->match, p->mask, decodePattern64(), getName(p->am));
-                    pMatch = p;
-                    return p->am;
-                }
+            for (p = curFormat->patterns; p->mask; p++)
+                if (((pattern ^ p->match) & p->mask) == 0)
+                    break;
+            if (traced && (p->mask || traceLevel == TRACE_ALL))
+                traceBit(p->mask ? p->am : 0);
+            if (p->mask) {
+                pMatch = p;
+                return p->am;
             }
         }
     }
@@ -636,12 +939,24 @@ int matchPattern2(bool lock) {
     return i == 16 ? 0 : -1;
 }
 
+static int match2Untraced(bool lock) {
+    return match2Kernel(lock, false);
+}
+
+static int match2Traced(bool lock) {
+    return match2Kernel(lock, true);
+}
+
+int matchPattern2(bool lock) {
+    return traceLevel ? match2Traced(lock) : match2Untraced(lock);
+}
+
 
 void setFormat(const char* fmtName) {
-    curFormat = lookupFormat(fmtName);
-    if (!curFormat)
+    formatInfo_t *fmt = lookupFormat(fmtName);
+    if (!fmt)
         logFull(D_FATAL, "Attempt to select unknown format %s\n", *fmtName == -128 ? fmtName + 1 : fmtName);
-
+    selectFormat(fmt);
 }
 
 
@@ -87,16 +87,24 @@ typedef struct {
 } formatInfo_t;
 
 extern formatInfo_t *curFormat;
+extern formatInfo_t formatInfo[];
 int decode(uint64_t pattern);
 uint64_t encode(uint32_t val, uint32_t prevPattern);
 int getByte();
 char *getName(int am);
+char *bin64Str(uint64_t pattern);
+char *decodePattern64();
 void makeHS5Patterns(unsigned cylinder, unsigned slot);
 void makeHS8Patterns(unsigned cylinder, unsigned slot);
 int matchPattern(int searchLimit);
 int matchPattern2(bool lock);
+void loadFormats(const char *fname);
+formatInfo_t *lookupFormat(const char *fmtName);
+uint64_t formatHash(const char *fmtName);
+void selectFormat(formatInfo_t *fmt);
 void setFormat(const char *fmtName);
 bool setInitialFormat(const char *fmtName);
 bool crc8(uint16_t* data, int len);
+int crcCorrect(uint16_t *data, int len, int skip);
 const char *getFormat(const char *userfmt);
 void showFormats();
\ No newline at end of file
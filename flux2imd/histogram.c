@@ -36,32 +36,25 @@
 #define HIST_SLOTS_PER_US    8   // slots per uS
 #define HIST_SLOTS   (HIST_MAX_US * HIST_SLOTS_PER_US)
 
+#define FINE_PER_SLOT   (1000 / HIST_SLOTS_PER_US / FLUXHISTNS)    // ingest histogram slots per display slot
+
 void displayHist(int levels)
 {
     uint32_t histogram[HIST_MAX_US * HIST_SLOTS_PER_US + 1] = { 0 };
     uint32_t maxHistCnt = 0;
-    int maxHistVal = 0;
     uint32_t outRange = 0;
-    int32_t val;
-    int32_t prevTs = 0;
-    int32_t newTs;
+    const fluxStats_t *fs = getFluxStats();
 
-    seekIndex(0);               // to start of data
-    int scnt = 0;
-    while ((newTs = getTs()) != EODATA) {
-        if (newTs >= 0) {        // ignore index markers
-            scnt++;
-            val = newTs - prevTs;
-            prevTs = newTs;
-            if (val > maxHistVal)
-                maxHistVal = val;
-            val = (val * HIST_SLOTS_PER_US + 500) / 1000; // scale to slots with rounding
-            if (val > HIST_SLOTS)
-                outRange++;
-            else if (++histogram[val] > maxHistCnt)
-                maxHistCnt++;
-        }
+    // the histogram gathered during ingest has finer slots, centred so that each
+    // display slot is made up of whole ingest slots
+    for (int i = 0; i < FLUXHISTSLOTS; i++) {
+        int val = (i + FINE_PER_SLOT / 2) / FINE_PER_SLOT;
+        if (val > HIST_SLOTS)
+            outRange += fs->hist[i];
+        else if ((histogram[val] += fs->hist[i]) > maxHistCnt)
+            maxHistCnt = histogram[val];
     }
+    int32_t maxHistVal = fs->maxInterval;
 
     if (maxHistCnt == 0) {
         logFull(ALWAYS, "No histogram data\n");
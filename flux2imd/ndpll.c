@@ -23,23 +23,29 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 #include "formats.h"
-#include <math.h>
+#include "dpll.h"
 #include "util.h"
 #include "flux.h"
-
+#include "stdflux.h"
+
+/*
+ * counter based dpll
+ * the cell is split into MAXCOUNTER counts, with the counter advanced every step ns
+ * frequency and phase corrections are applied based on where in the cell the transition is seen
+ * this is an alternative to the model in dpll.c and is used as the second engine in auto mode
+ */
 static unsigned history;
 static unsigned counter;
-static unsigned correction;
 static int32_t ctime, ftime;
 static unsigned step;
 static bool freqFixed = false;
+static uint8_t lastPhase;		// 3 msb of counter at the last transition
 
 #define MAXCOUNTER	4096
 #define PHASEHIGH	(256 + 200) // 258
 #define PHASELOW	(256 - 200) // 34
-#define TIGHTHIGH	(256 + 100)
-#define TIGHTLOW	(256 - 100)
 #define FREQHIGH	278 // 159
 #define FREQLOW		234 // 134
 #define FREQMID		256 // 146
@@ -52,6 +58,23 @@ static unsigned freqHigh = FREQHIGH;
 static unsigned freqLow = FREQLOW;
 static unsigned clockInc = FREQMID;
 
+// profile information, selected via the format's profileOrder as for dpll.c
+typedef struct {
+	unsigned tightPhase;		// phase window once tuned
+	unsigned tuneLimit1;		// frequency window after first tuning stage
+	unsigned tuneLimit2;		// and after second
+} adapt_t;
+
+static adapt_t profiles[] = {
+/* 0 */	{100, 8, 4},			// original model
+/* 1 */	{100, 6, 3},			// narrower frequency window
+/* 2 */	{80, 4, 2},				// narrow frequency & phase window
+/* 3 */	{120, 8, 4},			// hard sector, short blocks so allow more phase movement
+/* 4 */	{120, 6, 2},
+};
+
+#define CNTPROFILE  (int)(sizeof(profiles)/ sizeof(profiles[0]))
+static adapt_t *adapt = profiles;
 
 static int mode[8] = { 2, 1, 0, 0, 0, 0, 1 , 2 };		// [msb << 2 + history]
 static int freqCorrections[3][8] = {		// [mode][3 msb of counter]
@@ -67,43 +90,37 @@ static int phaseCorrections[8] = {			// [3 msb of counter]
 
 
 
-extern uint64_t pattern;
-extern uint16_t bits65_66;
-static uint32_t phaseTolerance;
 static unsigned bitCnts;
 static unsigned cntClockInc;
-static unsigned histInc[FREQHIGH - FREQLOW + 1];
 
 #define TUNESTART 16
 #define FREQTUNED1	  (TUNESTART + 400)
 #define FREQTUNED2	  (TUNESTART + 800)
 #define PHASETUNEEND (TUNESTART + 800)
 #define TUNEEND (FREQTUNED2 > PHASETUNEEND ? FREQTUNED2 : PHASETUNEEND)
-#define TUNELIMIT1	8
-#define TUNELIMIT2	4
 
 #define MODEL2
-int freqStep = 2;
+static int freqStep = 2;
 
-int getBit() {
+static int ctrGetBit() {
 	int bitRead = 0;
 	int transition = 0;
-	int iter = 0;
 	bits65_66 = ((bits65_66 << 1) + (pattern >> 63)) & 3;
 	pattern <<= 1;
 
 	while (counter < MAXCOUNTER) {
 		if ((ctime += step) >= ftime) {
 			bitRead = 1;
-			while ((ftime = getNextFlux()) < ctime)
+			while ((ftime = getTs()) < ctime)
 				if (ftime < 0)
-					return -1;
+					return ftime;
 		}
 
 		if (bitRead && !transition) {
 			history |= (counter >> 9) & 4;
 			freqCorrection = freqCorrections[mode[history]][(counter >> 9) & 7];
 			phaseCorrection = phaseCorrections[(counter >> 9) & 7];
+			lastPhase = (counter >> 9) & 7;
 			history >>= 1;
 			transition = 1;
 		}
@@ -133,23 +150,23 @@ int getBit() {
 		if (!freqFixed && bitCnts == FREQTUNED1) {
 			// get average of clockInc i.e. freq base
 			unsigned avgClockInt = (cntClockInc + (FREQTUNED1 - TUNESTART) / 2) / (FREQTUNED1 - TUNESTART);
-			if (avgClockInt + TUNELIMIT1 <= freqHigh)
-				freqHigh = avgClockInt + TUNELIMIT1;
-			if (avgClockInt - TUNELIMIT1 >= freqLow)
-				freqLow = avgClockInt - TUNELIMIT1;
+			if (avgClockInt + adapt->tuneLimit1 <= freqHigh)
+				freqHigh = avgClockInt + adapt->tuneLimit1;
+			if (avgClockInt - adapt->tuneLimit1 >= freqLow)
+				freqLow = avgClockInt - adapt->tuneLimit1;
 			freqStep = 1;
 		} else if (!freqFixed && bitCnts == FREQTUNED2) {
 			// get average of clockInc i.e. freq base
 			unsigned avgClockInt = (cntClockInc + (FREQTUNED2 - TUNESTART) / 2) / (FREQTUNED2 - TUNESTART);
-			if (avgClockInt + TUNELIMIT2 <= freqHigh)
-				freqHigh = avgClockInt + TUNELIMIT2;
-			if (avgClockInt - TUNELIMIT2 >= freqLow)
-				freqLow = avgClockInt - TUNELIMIT2;
+			if (avgClockInt + adapt->tuneLimit2 <= freqHigh)
+				freqHigh = avgClockInt + adapt->tuneLimit2;
+			if (avgClockInt - adapt->tuneLimit2 >= freqLow)
+				freqLow = avgClockInt - adapt->tuneLimit2;
 			freqFixed = true;
 		}
 		if (bitCnts == PHASETUNEEND) {
-			phaseHigh = TIGHTHIGH;
-			phaseLow = TIGHTLOW;
+			phaseHigh = 256 + adapt->tightPhase;
+			phaseLow = 256 - adapt->tightPhase;
 		}
 	 }
 #endif
@@ -157,43 +174,38 @@ int getBit() {
 	 return bitRead;
 }
 
-extern uint32_t nominalCellSize;
+static bool ctrRetrain(int profile) {
+	if (profile >= CNTPROFILE || profile >= (int)strlen(curFormat->profileOrder))
+		return false;
+	adapt = &profiles[curFormat->profileOrder[profile] - '0'];
 
-bool retrain(int profile, bool full) {
-	if (curFormat->encoding > E_M2FM8)
-		logFull(D_FATAL, "For %s unknown encoding %d\n", curFormat->name, curFormat->encoding);
-	nominalCellSize = curFormat->nominalCellSize;
 	step = 64 * (curFormat->nominalCellSize / 1000);
-	if (profile >= strlen(curFormat->profileOrder)) {
-		return false;
-	}
 	freqCorrection = 0;
 	phaseCorrection = 0;
-	if (full) {
-		phaseHigh = PHASEHIGH;
-		phaseLow = PHASELOW;
-		freqHigh = FREQHIGH;
-		freqLow = FREQLOW;
-		clockInc = FREQMID;
-		bitCnts = 0;
-		freqFixed = false;
-		freqStep = 2;
-	}
-	ctime = getNextFlux();
+	phaseHigh = PHASEHIGH;
+	phaseLow = PHASELOW;
+	freqHigh = FREQHIGH;
+	freqLow = FREQLOW;
+	clockInc = FREQMID;
+	bitCnts = 0;
+	freqFixed = false;
+	freqStep = 2;
+	history = 0;
 	counter = 0;
-
 	pattern = 0;
 
-	return ((ftime = getNextFlux()) > 0);
+	while ((ctime = getTs()) < 0)
+		if (ctime == EODATA)
+			return false;			// prime dpll with first sample
+	while ((ftime = getTs()) < 0)
+		if (ftime == EODATA)
+			return false;
+	return true;
 }
 
-void retune() {
-	phaseHigh = PHASEHIGH;
-	phaseLow = PHASELOW;
-//	freqHigh = FREQHIGH;
-//	freqLow = FREQLOW;
-//	clockInc = FREQMID;
-//	freqFixed = false;
-//	freqStep = 2;
-	bitCnts = 0;
-}
\ No newline at end of file
+static void ctrState(uint16_t *cellSize, uint8_t *phase) {
+	*cellSize = (uint16_t)(step * MAXCOUNTER / clockInc);
+	*phase = lastPhase * 2;
+}
+
+const DpllFunc ctrDpll = { "ctr", &ctrGetBit, &ctrRetrain, &ctrState };
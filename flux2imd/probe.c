@@ -0,0 +1,117 @@
+/****************************************************************************
+ *  program: flux2imd - create imd image file from kryoflux file            *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+    probe mode
+    gives a quick report on a disk image before committing to a full decode.
+    Only a sample of the cylinders is loaded and for each of these only the first revolution
+    is decoded, using the first dpll profile. The results are summarised in one line per file
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "container.h"
+#include "flux2imd.h"
+#include "probe.h"
+#include "stats.h"
+#include "stdflux.h"
+#include "trackManager.h"
+#include "util.h"
+
+#define MAXTALLY    16
+
+typedef struct {
+    const char *name;
+    int value;
+    unsigned cnt;
+} tally_t;
+
+// count occurrences of a name or value, returns the most common
+static tally_t *tally(tally_t *list, const char *name, int value) {
+    tally_t *best = list;
+    int i;
+    for (i = 0; i < MAXTALLY && list[i].cnt; i++)
+        if (name ? strcmp(list[i].name, name) == 0 : list[i].value == value)
+            break;
+    if (i < MAXTALLY) {
+        list[i].name  = name;
+        list[i].value = value;
+        list[i].cnt++;
+    }
+    for (i = 1; i < MAXTALLY && list[i].cnt; i++)
+        if (list[i].cnt > best->cnt)
+            best = &list[i];
+    return best;
+}
+
+void probeHeader() {
+    printf("%-40s %-12s %3s %6s %6s %6s %6s %9s\n", "Archive", "Format", "HS", "RPM", "Cell", "Tracks", "IDAM%",
+           "Time(s)");
+}
+
+bool probeFile(const char *name, char const *usrfmt) {
+    tally_t formats[MAXTALLY] = { { NULL, 0, 0 } };
+    tally_t cells[MAXTALLY]   = { { NULL, 0, 0 } };
+    tally_t *format           = formats;
+    tally_t *cell             = cells;
+    unsigned tracks           = 0;
+    unsigned decoded          = 0;
+    unsigned slots            = 0;
+    unsigned good             = 0;
+    int hs                    = 0;
+    double rpm                = 0.0;
+    uint64_t start            = usClock();
+
+    if (!openFluxFile(name))
+        return false;
+    while (loadFluxStream()) {
+        tracks++;
+        hs = getHsCnt();
+        rpm += getMeasuredRPM();
+        cell = tally(cells, NULL, getCellWidth());
+        if (probeTrack(usrfmt)) {
+            decoded++;
+            format = tally(formats, trackPtr->fmt->name, 0);
+            slots += trackPtr->fmt->spt;
+            // hard sector decoders set the idams from the sector slots, so use the data instead
+            good += hs ? trackPtr->cntGoodData : trackPtr->cntGoodIdam;
+        }
+    }
+    removeDisk();
+    closeFluxFile();
+
+    char fmtName[32];
+    // a trailing + shows more than one format was seen
+    snprintf(fmtName, sizeof(fmtName), "%s%s", decoded ? format->name : "unknown", formats[1].cnt ? "+" : "");
+    printf("%-40s ", basename(name));
+    if (tracks == 0)
+        printf("%-12s\n", "no tracks");
+    else
+        printf("%-12s %3d %6.1f %6d %6u %5.0f%% %9.2f\n", fmtName, hs, rpm / tracks,
+               cell->value, tracks, slots ? 100.0 * good / slots : 0.0, (usClock() - start) / 1e6);
+    return true;
+}
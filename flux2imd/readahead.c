@@ -0,0 +1,167 @@
+/****************************************************************************
+ *  program: flux2imd - create imd image file from kryoflux file            *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+    read ahead of the container data
+    a reader thread fetches the next tracks from the container, doing the file I/O and any
+    inflating, while the main thread decodes the current track. The fetched tracks are queued,
+    limited both in number and in total size. Loading the data into the flux stream is left to
+    the main thread, as is any logging, so the reader only touches the container's own state.
+    With a depth of 0 the tracks are fetched as they are needed, without the thread
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#endif
+#include "readahead.h"
+#include "util.h"
+
+static unsigned depth = 4;
+static uint64_t limit = 64 << 20;
+
+static bool (*fetchFunc)(fluxImage_t *image);
+static bool running;                // reader thread started
+static thrd_t reader;
+static mtx_t lock;
+static cnd_t notEmpty;
+static cnd_t notFull;
+
+static fluxImage_t *queue;          // circular buffer of depth entries
+static unsigned qHead;
+static unsigned qCnt;
+static uint64_t qBytes;
+static bool endOfData;
+static bool stopping;
+
+void setReadAhead(unsigned newDepth, unsigned limitMB) {
+    depth = newDepth;
+    limit = (uint64_t)limitMB << 20;
+}
+
+void setImageName(fluxImage_t *image, const char *name) {
+    free(image->name);
+    image->name = strcpy((char *)xmalloc(strlen(name) + 1), name);
+}
+
+void releaseImage(fluxImage_t *image) {
+    if (image->data) {
+        if (!image->mapped)
+            free(image->data);
+#ifndef _MSC_VER
+        else
+            munmap(image->data, image->size);
+#endif
+    }
+    free(image->name);
+    memset(image, 0, sizeof(fluxImage_t));
+}
+
+static int readerMain(void *arg) {
+    (void)arg;
+    fluxImage_t image = { IMG_OK, NULL, 0, NULL, 0, false };
+
+    for (;;) {
+        bool more = fetchFunc(&image);
+        mtx_lock(&lock);
+        // the image in hand is always queued if the queue is empty, even if over the size limit
+        while (more && !stopping && qCnt && (qCnt == depth || qBytes + image.size > limit))
+            cnd_wait(&notFull, &lock);
+        if (!more || stopping) {
+            endOfData = true;
+            cnd_signal(&notEmpty);
+            mtx_unlock(&lock);
+            releaseImage(&image);
+            return 0;
+        }
+        queue[(qHead + qCnt++) % depth] = image;
+        qBytes += image.size;
+        cnd_signal(&notEmpty);
+        mtx_unlock(&lock);
+        memset(&image, 0, sizeof(image));
+    }
+}
+
+void readAheadStart(bool (*fetch)(fluxImage_t *image)) {
+    static bool initialised;
+
+    fetchFunc = fetch;
+    if (depth == 0)
+        return;
+    if (!initialised) {
+        mtx_init(&lock, mtx_plain);
+        cnd_init(&notEmpty);
+        cnd_init(&notFull);
+        queue       = (fluxImage_t *)xmalloc(depth * sizeof(fluxImage_t));
+        initialised = true;
+    }
+    qHead = qCnt = 0;
+    qBytes       = 0;
+    endOfData = stopping = false;
+    if (thrd_create(&reader, readerMain, NULL) == thrd_success)
+        running = true;
+    else
+        logFull(D_WARNING, "Cannot start read ahead, reading tracks as needed\n");
+}
+
+bool readAheadNext(fluxImage_t *image) {
+    memset(image, 0, sizeof(fluxImage_t));
+    if (!running)
+        return fetchFunc && fetchFunc(image);
+
+    mtx_lock(&lock);
+    while (qCnt == 0 && !endOfData)
+        cnd_wait(&notEmpty, &lock);
+    bool result = qCnt != 0;
+    if (result) {
+        *image = queue[qHead];
+        qHead  = (qHead + 1) % depth;
+        qCnt--;
+        qBytes -= image->size;
+        cnd_signal(&notFull);
+    }
+    mtx_unlock(&lock);
+    return result;
+}
+
+void readAheadStop() {
+    if (running) {
+        mtx_lock(&lock);
+        stopping = true;
+        cnd_signal(&notFull);
+        mtx_unlock(&lock);
+        thrd_join(reader, NULL);
+        while (qCnt) {
+            releaseImage(&queue[qHead]);
+            qHead = (qHead + 1) % depth;
+            qCnt--;
+        }
+        running = false;
+    }
+    fetchFunc = NULL;
+}
@@ -0,0 +1,49 @@
+/****************************************************************************
+ *  program: flux2imd - create imd image file from kryoflux file            *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+enum { IMG_OK, IMG_SKIP, IMG_ERROR };       // status of a fetched image
+
+// the data for one track as read from the container, before it is loaded into the flux stream
+typedef struct {
+    int status;
+    char *name;             // entry or file name, identifies the track
+    int track;              // container specific track number
+    uint8_t *data;
+    size_t size;
+    bool mapped;            // data is a mapped file rather than allocated
+} fluxImage_t;
+
+void setReadAhead(unsigned depth, unsigned limitMB);
+void readAheadStart(bool (*fetch)(fluxImage_t *image));     // fetch returns false at the end of the container
+bool readAheadNext(fluxImage_t *image);
+void readAheadStop();
+void setImageName(fluxImage_t *image, const char *name);
+void releaseImage(fluxImage_t *image);
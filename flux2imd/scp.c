@@ -6,9 +6,12 @@
 #include "stdflux.h"
 #include "scp.h"
 #include "util.h"
+#include "stats.h"
+#include "readahead.h"
 
 
 #define MAXREV  10      // maximum number of revolutions (normally 5)
+#define MAXTRKSIZE  (16 << 20)  // sanity limit on a track's data
 
 
 static FILE *scpFp;
@@ -26,6 +29,9 @@ static struct {
 
 
 
+bool isSampledCyl(int cylinder);      // container.c
+void expectTrack(int track);          // container.c
+
 static uint32_t scp32(FILE *scpFp) {
     uint32_t val = 0;
     for (int i = 0; i < 32; i += 8)
@@ -63,6 +69,9 @@ bool scpOpen(const char *fname) {
     if (!(scpHeader[IFF_FLAGS] & (1 << FB_INDEX)))
         logFull(D_WARNING, "data is not index pulse aligned\n");
     scpFname = fname;
+    for (int trk = curTrack; trk <= scpHeader[IFF_END]; trk += scpHeader[IFF_HEADS] == 0 ? 1 : 2)
+        if (trkOffset[trk] && isSampledCyl(trk / 2))
+            expectTrack(trk);       // tracks scpFetch will return
     if (scpHeader[IFF_NUMREVS] > MAXREV) {
         scpHeader[IFF_NUMREVS] = MAXREV;
         logFull(D_WARNING, "Revolutions limited to %d\n", MAXREV);
@@ -83,33 +92,69 @@ bool scpClose() {
 
 
 
-int32_t scpSample(FILE *fp) {
-    int ch, cl;
-    if ((ch = getc(fp)) != EOF  && (cl = getc(fp)) != EOF)
-            return (ch << 8) + cl;
-    return EOF;
+static uint32_t le32(const uint8_t *p) {
+    return p[0] + (p[1] << 8) + (p[2] << 16) + ((uint32_t)p[3] << 24);
+}
+
+// read the track header and flux data into memory, called from the read ahead thread
+bool scpFetch(fluxImage_t *image) {
+    uint8_t trkHdr[4 + 12 * MAXREV];
+    uint32_t hdrLen = 4 + 12 * scpHeader[IFF_NUMREVS];
+
+    while (curTrack <= scpHeader[IFF_END]) {
+        int trk = curTrack;
+        curTrack += scpHeader[IFF_HEADS] == 0 ? 1 : 2;
+        if (!trkOffset[trk] || !isSampledCyl(trk / 2))
+            continue;
+        image->track  = trk;
+        image->status = IMG_ERROR;
+        if (fseek(scpFp, trkOffset[trk], SEEK_SET) == 0 && fread(trkHdr, 1, hdrLen, scpFp) == hdrLen) {
+            uint32_t size = hdrLen;         // extend to the end of the last revolution's data
+            for (int i = 0; i < scpHeader[IFF_NUMREVS]; i++) {
+                uint32_t end = le32(trkHdr + 12 + 12 * i) + 2 * le32(trkHdr + 8 + 12 * i);
+                if (end > size)
+                    size = end;
+            }
+            if (size <= MAXTRKSIZE && fseek(scpFp, trkOffset[trk], SEEK_SET) == 0) {
+                image->data   = (uint8_t *)xmalloc(size);
+                image->size   = fread(image->data, 1, size, scpFp);     // short if truncated, reported on load
+                image->status = IMG_OK;
+            }
+        }
+        return true;
+    }
+    return false;
 }
 
-bool scpLoadTrk(uint16_t trk) {
-    char ct[10];
-    uint8_t trkHdr[4];
+bool scpLoad(fluxImage_t *image) {
+    char ct[24];
+    int trk           = image->track;
+    const uint8_t *p  = image->data;
+    uint32_t hdrLen   = 4 + 12 * scpHeader[IFF_NUMREVS];
+
     sprintf(ct, "%d,%d", trk / 2, trk % 2);
     setLogPrefix(scpFname, ct);
-    if (fseek(scpFp, trkOffset[trk], SEEK_SET) ||
-        fread(trkHdr, 1, 4, scpFp) != 4 ||
-        memcmp(trkHdr, "TRK", 3) != 0 ||
-        trkHdr[3] != trk) {
+    if (image->status != IMG_OK || image->size < hdrLen ||
+        memcmp(p, "TRK", 3) != 0 ||
+        p[3] != trk) {
         logFull(D_WARNING, "track info missing\n");
         return false;
     }
     uint32_t fluxTotal = 0;
     for (int i = 0; i < scpHeader[IFF_NUMREVS]; i++) {
-        trkData[i].rpm = 60.0 / (scp32(scpFp) * 25e-9);
-        fluxTotal += trkData[i].fluxCnt = scp32(scpFp);
-        trkData[i].base = scp32(scpFp);
+        trkData[i].rpm = 60.0 / (le32(p + 4 + 12 * i) * 25e-9);
+        fluxTotal += trkData[i].fluxCnt = le32(p + 8 + 12 * i);
+        trkData[i].base = le32(p + 12 + 12 * i);
     }
+    stats.bytes += 4 + 12 * scpHeader[IFF_NUMREVS] + 2 * fluxTotal;
     double sclk = 1 / (25e-9 * (scpHeader[IFF_RESOLUTION] + 1));
-    beginFlux(fluxTotal, scpHeader[IFF_NUMREVS] + 1, sclk, (scpHeader[IFF_FLAGS] & (1 << FB_RPM)) ? 360.0 : 300.0, 0);
+    double revRpm[MAXREV];      // the nominal speed is chosen from the measured revolutions
+    for (int i = 0; i < scpHeader[IFF_NUMREVS]; i++)
+        revRpm[i] = trkData[i].rpm;
+    double rpm = scpHeader[IFF_NUMREVS] ? nominalRPM(revRpm, scpHeader[IFF_NUMREVS])
+                                        : (scpHeader[IFF_FLAGS] & (1 << FB_RPM)) ? 360.0 : 300.0;
+    beginFlux(fluxTotal, scpHeader[IFF_NUMREVS] + 1, sclk, rpm, 0);
+    setIndexClock(40e6);                // index times are in 25ns units
     setCylHead(trk / 2, trk % 2);
     int32_t delta = 0;
     int32_t sample;
@@ -117,15 +162,12 @@ bool scpLoadTrk(uint16_t trk) {
     for (int i = 0; loaded && i < scpHeader[IFF_NUMREVS]; i++) {
         setActualRPM(trkData[i].rpm);
         addIndex(SSSTART, 0);
-        if (fseek(scpFp, trkOffset[trk] + trkData[i].base, SEEK_SET)) {
-            loaded = false;
-            break;
-        }
-        for (uint32_t j = 0; j < trkData[i].fluxCnt; j++) {
-            if ((sample = scpSample(scpFp)) == EOF) {
+        uint32_t pos = trkData[i].base;
+        for (uint32_t j = 0; j < trkData[i].fluxCnt; j++, pos += 2) {
+            if (pos + 2 > image->size) {
                 loaded = false;
                 break;
-            } else if (sample == 0)
+            } else if ((sample = (p[pos] << 8) + p[pos + 1]) == 0)
                 delta += 0x1000;
             else {
                 addDelta(delta + sample);
@@ -140,17 +182,3 @@ bool scpLoadTrk(uint16_t trk) {
         endFlux();
     return loaded;
 }
-
-bool scpLoad() {
-    bool loaded = false;
-
-    while (!loaded && curTrack <= scpHeader[IFF_END]) {
-        setLogPrefix(scpFname, NULL);
-        if (trkOffset[curTrack])
-            loaded = scpLoadTrk(curTrack);
-        curTrack += scpHeader[IFF_HEADS] == 0 ? 1 : 2;
-    }
-    return loaded;
-}
-
-
@@ -38,6 +38,8 @@
 #include "stdflux.h"
 
 static int prevSlot = -1;
+static readInfo_t readPos;      // where the next data added was read, valid if readSet
+static bool readSet;
 static int curSpacing;
 static int minSpacing;
 static int maxSpacing;
@@ -49,7 +51,7 @@ static void chkSpacingChange(int newSpacing) {
     for (formatInfo_t *p = curFormat + 1; p->encoding == curFormat->encoding && p->sSize == curFormat->sSize; p++) {
         if (abs(p->spacing - newSpacing) < 3) {
             DBGLOG(D_DECODER, "Updated format to %s\n", p->name);
-            curFormat = p;
+            selectFormat(p);
             minSpacing = (uint16_t)(curFormat->spacing * 0.97);
             maxSpacing = (uint16_t)(curFormat->spacing * 1.03);
             updateTrackFmt();
@@ -182,42 +184,128 @@ void addIdam(int pos, idam_t *idam) {
     }
 }
 
+/*
+ * when over the memory budget only MAXBADCOPIES bad copies of a sector are kept. A new
+ * copy replaces the one with the most suspect bytes if it has fewer, otherwise it is
+ * dropped. Returns true if the new copy should be added, with reuse set to the replaced
+ * copy so its space in the track's arena can hold the new one
+ */
+#define MAXBADCOPIES    4
+
+static unsigned suspectCnt(sectorData_t const *p) {
+    unsigned cnt = 0;
+    for (unsigned i = 0; p->suspect && i < p->len; i++)
+        if (isSuspect(p, i))
+            cnt++;
+    return cnt;
+}
+
+static bool keepBadCopy(sector_t *p, unsigned newCnt, sectorDataList_t **reuse) {
+    unsigned copies = 0;
+    sectorDataList_t **worst = NULL;
+    unsigned worstCnt = 0;
+
+    for (sectorDataList_t **q = &p->sectorDataList; *q; q = &(*q)->next) {
+        unsigned cnt = suspectCnt(&(*q)->sectorData);
+        if (copies++ == 0 || cnt > worstCnt) {
+            worst = q;
+            worstCnt = cnt;
+        }
+    }
+    if (copies < MAXBADCOPIES)
+        return true;
+    if (newCnt >= worstCnt)
+        return false;
+    *reuse = *worst;
+    *worst = (*worst)->next;
+    p->voteCnt = 0;                         // copies have changed so vote again
+    return true;
+}
+
+
+/*
+ * fromTs is the start of the index block and amTs the time the data address mark was found.
+ * Data added without this, i.e. voted or corrected, keeps the position of the bad copies
+ */
+void setReadPos(int profile, int revolution, int32_t fromTs, int32_t amTs) {
+    readPos.profile    = (uint8_t)profile;
+    readPos.revolution = (uint8_t)revolution;
+    readPos.indexNs    = amTs - fromTs;
+    readPos.bitPos     = readPos.indexNs / curFormat->nominalCellSize / 2;
+    readSet            = true;
+}
 
 void addSectorData(int pos, bool isGood, unsigned len, uint16_t rawData[]) {
     unsigned slot = slotAt(pos, false);
     sector_t *p = &trackPtr->sectors[slot];
-    sectorDataList_t *q;
+    sectorDataList_t *q = NULL;
+    bool isRead = readSet;
 
+    readSet = false;
+    if (isRead && p->read.reads < UINT16_MAX)
+        p->read.reads++;
     if (p->status & SS_DATAGOOD) {     // already have good data
-        if (isGood && memcmp(p->sectorDataList->sectorData.rawData, rawData, len * sizeof(rawData[0])) != 0)
-            logFull(ALWAYS, "@slot %d valid sectors with different data\n", slot);
+        if (isGood) {
+            uint8_t *data = p->sectorDataList->sectorData.data;
+            for (unsigned i = 0; i < len; i++)
+                if (data[i] != (rawData[i] & 0xff)) {
+                    logFull(ALWAYS, "@slot %d valid sectors with different data\n", slot);
+                    break;
+                }
+        }
         return;
     }
 
     if (isGood) {
         p->status |= SS_DATAGOOD;
-        removeSectorData(p->sectorDataList);        // remove any previous bad sector data
-        p->sectorDataList = NULL;
+        p->sectorDataList = NULL;                   // drop any previous bad sector data
         trackPtr->cntGoodData++;
         trackPtr->cntAnyData++;
-    } else if (!p->sectorDataList)
+    }
+    unsigned suspect = 0;
+    for (unsigned i = 0; i < len; i++)
+        if (rawData[i] & SUSPECT)
+            suspect++;
+    if (!isGood && p->sectorDataList && isOverBudget() && !keepBadCopy(p, suspect, &q))
+        return;
+
+    // note where good data or the bad copy with fewest suspect bytes was read
+    if (isGood || !p->sectorDataList || suspect < p->read.suspect) {
+        if (isRead) {
+            uint16_t reads = p->read.reads;
+            p->read        = readPos;
+            p->read.reads  = reads;
+        }
+        p->read.suspect = suspect;
+    }
+    if (!isGood && !p->sectorDataList)
         trackPtr->cntAnyData++;
 
-    // put data at head of list
-    q = (sectorDataList_t *)xmalloc(sizeof(sectorDataList_t) + len * sizeof(q->sectorData.rawData[0]));
+    // store the data bytes, with a bitmap of any suspect bytes after them
+    bool hasSuspect = suspect != 0;
+
+    // put data at head of list, in place of a replaced copy if it is big enough
+    if (q && (!q->sectorData.suspect || q->sectorData.len != len))
+        q = NULL;
+    if (!q)
+        q = (sectorDataList_t *)diskAlloc(sizeof(sectorDataList_t) + len + (hasSuspect ? (len + 7) / 8 : 0));
     q->sectorData.len = len;
-    memcpy(q->sectorData.rawData, rawData, len * sizeof(q->sectorData.rawData[0]));
+    q->sectorData.suspect = hasSuspect ? q->sectorData.data + len : NULL;
+    if (hasSuspect)
+        memset(q->sectorData.suspect, 0, (len + 7) / 8);
+    for (unsigned i = 0; i < len; i++) {
+        q->sectorData.data[i] = (uint8_t)rawData[i];
+        if (rawData[i] & SUSPECT)
+            q->sectorData.suspect[i / 8] |= 1 << (i % 8);
+    }
     q->next = p->sectorDataList;
     p->sectorDataList = q;
 }
 
-
-void removeSectorData(sectorDataList_t *p) {
-    sectorDataList_t *q;
-    for (; p; p = q) {
-        q = p->next;
-        free(p);
-    }
+// expand packed sector data back to the decoder format, with SUSPECT markers
+void unpackSectorData(sectorData_t const *p, uint16_t *rawData) {
+    for (unsigned i = 0; i < p->len; i++)
+        rawData[i] = p->data[i] | (isSuspect(p, i) ? SUSPECT : 0);
 }
 
 
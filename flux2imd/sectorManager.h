@@ -34,7 +34,7 @@
 #define POSJITTER   40
 
 enum {
-    SS_IDAMGOOD = 1, SS_DATAGOOD = 2, SS_GOOD = 3, SS_FIXED = 4,
+    SS_IDAMGOOD = 1, SS_DATAGOOD = 2, SS_GOOD = 3, SS_FIXED = 4, SS_VOTED = 8, SS_CORRECTED = 16,
 };
 
 typedef struct {
@@ -46,24 +46,40 @@ typedef struct {
 
 typedef struct {
     unsigned len;           // of data including CRC & any link data
-    uint16_t rawData[0];       // extended as needed 
+    uint8_t *suspect;       // bitmap of bytes the decoder marked as SUSPECT, NULL if none
+    uint8_t data[];         // extended as needed, followed by the suspect bitmap if present
 } sectorData_t;
 
+#define isSuspect(p, i)     ((p)->suspect && ((p)->suspect[(i) / 8] & (1 << ((i) % 8))))
+
 typedef struct _sectorDataList {
     struct _sectorDataList* next;
     sectorData_t sectorData;           // unnamed structure
 } sectorDataList_t;
 
 
+// where the sector's data was read, for good data the read that gave it, else the best bad copy
+typedef struct {
+    uint16_t reads;         // copies of the data read, 0 if none
+    uint16_t suspect;       // suspect bytes in the copy
+    uint8_t profile;        // dpll profile
+    uint8_t revolution;     // counted from the first index (hole) decoded
+    uint32_t bitPos;        // data bits from the index (hole) to the data address mark
+    uint32_t indexNs;       // time from the index (hole) to the data address mark
+} readInfo_t;
 
 typedef struct _sector {
     unsigned status;
     idam_t idam;
+    unsigned voteCnt;                   // number of copies used in the last vote
+    uint8_t capture;                    // capture the sector was decoded from when fusing captures
+    readInfo_t read;
     sectorDataList_t* sectorDataList;
 } sector_t;
 
 
 void addIdam(int pos, idam_t* idam);
 void addSectorData(int pos, bool isGood, unsigned len, uint16_t rawData[]);
-void removeSectorData(sectorDataList_t* p);
+void setReadPos(int profile, int revolution, int32_t fromTs, int32_t amTs);   // call before adding data read from the flux
+void unpackSectorData(sectorData_t const *p, uint16_t *rawData);
 void resetTracker();
\ No newline at end of file
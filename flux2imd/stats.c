@@ -0,0 +1,329 @@
+/****************************************************************************
+ *  program: flux2imd - create imd image file from kryoflux file            *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+    per stage counters and timers
+    these are always collected as the cost is only a few increments, but are only written
+    to a json file if requested. Each track has a record of the counters and times accrued
+    whilst loading and decoding it, the file record adds the IMD write time and totals.
+    Batch mode puts the records for all of the files in a single json file, with overall totals
+    The flux statistics gathered as each track is ingested are added to the track's record and
+    can also be written, with the interval histogram, to a csv file per input file
+    A per sector quality map of the decoded disk can also be written to a .sec.csv file
+*/
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+#include "stdflux.h"
+#include "trackManager.h"
+#include "util.h"
+#ifdef __GNUC__
+#include <limits.h>
+#define _MAX_PATH PATH_MAX
+#endif
+
+stats_t stats;
+
+static bool enabled;
+static bool csvEnabled;
+static bool secEnabled;
+static FILE *jsonFp;
+static FILE *csvFp;
+static FILE *secFp;
+static char const *batchFile;   // set if aggregating
+static stats_t trackBase;       // counters at end of previous track
+static stats_t fileBase;        // counters at start of file
+static stats_t batchBase;
+static int trackCnt;
+static int fileCnt;
+
+static struct {
+    char *name;
+    size_t offset;
+} const fields[] = {
+    { "tracks", offsetof(stats_t, tracks) },
+    { "bytes", offsetof(stats_t, bytes) },
+    { "transitions", offsetof(stats_t, transitions) },
+    { "dpll_bits", offsetof(stats_t, dpllBits) },
+    { "pattern_tests", offsetof(stats_t, patternTests) },
+    { "crc_calls", offsetof(stats_t, crcCalls) },
+    { "revolutions", offsetof(stats_t, revolutions) },
+    { "restarts", offsetof(stats_t, restarts) },
+    { "dpll_retries", offsetof(stats_t, dpllRetries) },
+    { "allocations", offsetof(stats_t, allocations) },
+    { "cache_hits", offsetof(stats_t, cacheHits) },
+    { "load_us", offsetof(stats_t, loadUs) },
+    { "decode_us", offsetof(stats_t, decodeUs) },
+    { "write_us", offsetof(stats_t, writeUs) }
+};
+
+#define FIELD(p, i) *(uint64_t *)((char *)(p) + fields[i].offset)
+
+uint64_t usClock() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// write the difference between cur and base, skipping fields not relevant to a track
+static void writeCounters(stats_t const *cur, stats_t const *base, bool isTrack) {
+    for (unsigned i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+        if (!isTrack || (fields[i].offset != offsetof(stats_t, tracks) && fields[i].offset != offsetof(stats_t, writeUs)))
+            fprintf(jsonFp, "\"%s\": %llu, ", fields[i].name, (unsigned long long)(FIELD(cur, i) - FIELD(base, i)));
+    fputs("\"profiles\": [", jsonFp);
+    for (int i = 0; i < STATPROFILES; i++)
+        fprintf(jsonFp, "%s%llu", i ? ", " : "", (unsigned long long)(cur->profiles[i] - base->profiles[i]));
+    fputc(']', jsonFp);
+}
+
+static void writeString(char const *s) {
+    fputc('"', jsonFp);
+    for (; *s; s++)
+        if (*s == '"' || *s == '\\')
+            fprintf(jsonFp, "\\%c", *s);
+        else if ((unsigned char)*s < ' ')
+            fprintf(jsonFp, "\\u%04x", *s);
+        else
+            fputc(*s, jsonFp);
+    fputc('"', jsonFp);
+}
+
+// the flux statistics for the current track
+static void writeFlux() {
+    const fluxStats_t *fs = getFluxStats();
+    fprintf(jsonFp, ", \"cell_ns\": %d, \"jitter_ns\": %.1f, \"rpm\": %.2f, \"rpm_min\": %.2f, \"rpm_max\": %.2f, \"drift_pct\": %.3f",
+            fs->cellWidth, fs->jitter, fs->meanRpm, fs->minRpm, fs->maxRpm, fs->drift);
+}
+
+static void writeCsv(int cyl, int head) {
+    const fluxStats_t *fs = getFluxStats();
+    fprintf(csvFp, "%d,%d,%u,%d,%.1f,%d,%.2f,%.2f,%.2f,%.3f,%d", cyl, head, fs->samples, fs->cellWidth, fs->jitter,
+            fs->rpmCnt, fs->minRpm, fs->meanRpm, fs->maxRpm, fs->drift, fs->maxInterval);
+    for (int i = 0; i < FLUXHISTSLOTS; i++)
+        fprintf(csvFp, ",%u", fs->hist[i]);
+    fputc('\n', csvFp);
+}
+
+/*
+ * one line per sector of the disk model, so it covers fused captures and tracks already
+ * released once written. idam is good, fixed (id implied) or bad, data is good, voted,
+ * corrected, bad or none. The read columns are blank if the data was never read
+ */
+static void writeSectorMap() {
+    for (int cyl = 0; cyl <= maxCylinder; cyl++)
+        for (int head = 0; head <= maxHead; head++) {
+            track_t const *pTrack = getTrack(cyl, head);
+            for (int slot = 0; pTrack && slot < pTrack->fmt->spt; slot++) {
+                sector_t const *p = &pTrack->sectors[slot];
+                char const *idam  = (p->status & SS_FIXED) ? "fixed" : (p->status & SS_IDAMGOOD) ? "good" : "bad";
+                char const *data  = !(p->status & SS_DATAGOOD) ? (p->read.reads ? "bad" : "none")
+                                    : (p->status & SS_CORRECTED) ? "corrected"
+                                    : (p->status & SS_VOTED)     ? "voted"
+                                                                 : "good";
+                fprintf(secFp, "%d,%d,%d,", cyl, head, slot);
+                if (pTrack->slotToSector[slot] != 0xff)
+                    fprintf(secFp, "%d", pTrack->slotToSector[slot]);
+                fprintf(secFp, ",%s,%s,%d,%u", idam, data, p->capture + 1, p->read.reads);
+                if (p->read.reads)
+                    fprintf(secFp, ",%d,%d,%u,%u,%u\n", p->read.profile, p->read.revolution, p->read.suspect,
+                            p->read.bitPos, p->read.indexNs);
+                else
+                    fputs(",,,,,\n", secFp);
+            }
+        }
+}
+
+// name the file after fname with its extent replaced by ext
+static char *sidecarName(char *name, const char *fname, const char *ext) {
+    strcpy(name, fname);
+    char *s = strrchr(name, '.');
+    strcpy(s && !strpbrk(s, "/\\") ? s : strchr(name, 0), ext);
+    return name;
+}
+
+static FILE *createFile(char const *fname) {
+    FILE *fp;
+    if ((fp = fopen(fname, "wt")) == NULL)
+        logFull(D_ERROR, "cannot create %s\n", fname);
+    return fp;
+}
+
+void statsOpen(const char *batchName) {
+    enabled   = true;
+    batchFile = batchName && *batchName ? batchName : NULL;
+    batchBase = stats;
+}
+
+void statsCsv() {
+    csvEnabled = true;
+}
+
+void statsSectors() {
+    secEnabled = true;
+}
+
+void statsBeginFile(const char *fname) {
+    char name[_MAX_PATH + 1];
+    if (csvEnabled && (csvFp = createFile(sidecarName(name, fname, ".csv")))) {
+        fputs("cyl,head,samples,cell_ns,jitter_ns,rpm_cnt,rpm_min,rpm,rpm_max,drift_pct,max_ns", csvFp);
+        for (int i = 0; i < FLUXHISTSLOTS; i++)
+            fprintf(csvFp, ",ns%d", i * FLUXHISTNS);
+        fputc('\n', csvFp);
+    }
+    if (secEnabled && (secFp = createFile(sidecarName(name, fname, ".sec.csv"))))
+        fputs("cyl,head,slot,sector,idam,data,capture,reads,profile,revolution,suspect,bit_pos,index_ns\n", secFp);
+    if (!enabled)
+        return;
+    if (!batchFile)
+        jsonFp = createFile(sidecarName(name, fname, ".json"));
+    else if (fileCnt == 0 && (jsonFp = createFile(batchFile)))
+        fputs("{\n\"files\": [\n", jsonFp);
+    if (!jsonFp)
+        return;
+    fputs(fileCnt++ && batchFile ? ",\n{\n\"file\": " : "{\n\"file\": ", jsonFp);
+    writeString(basename(fname));
+    fputs(",\n\"tracks\": [", jsonFp);
+    fileBase = trackBase = stats;
+    trackCnt = 0;
+}
+
+// call after the track's load and decode times have been added
+void statsEndTrack(int cyl, int head) {
+    stats.tracks++;
+    if (csvFp)
+        writeCsv(cyl, head);
+    if (!jsonFp)
+        return;
+    fprintf(jsonFp, "%s\n  {\"cyl\": %d, \"head\": %d, ", trackCnt++ ? "," : "", cyl, head);
+    writeCounters(&stats, &trackBase, true);
+    writeFlux();
+    fputc('}', jsonFp);
+    trackBase = stats;
+}
+
+void statsEndFile() {
+    if (csvFp) {
+        fclose(csvFp);
+        csvFp = NULL;
+    }
+    if (secFp) {
+        writeSectorMap();
+        fclose(secFp);
+        secFp = NULL;
+    }
+    if (!jsonFp)
+        return;
+    fputs("\n],\n\"totals\": {", jsonFp);
+    writeCounters(&stats, &fileBase, false);
+    fputs("}\n}", jsonFp);
+    if (!batchFile) {
+        fputc('\n', jsonFp);
+        fclose(jsonFp);
+        jsonFp = NULL;
+    }
+}
+
+void statsClose() {
+    if (!jsonFp)
+        return;
+    fputs("\n],\n\"totals\": {", jsonFp);
+    writeCounters(&stats, &batchBase, false);
+    fputs("}\n}\n", jsonFp);
+    fclose(jsonFp);
+    jsonFp = NULL;
+}
+
+/*
+ * batch workers each write a .json file per input file. The runner copies their records,
+ * in input order, into the batch file and sums the totals from each, so the batch file
+ * matches the one a single process would write. The workers' files are then removed
+ */
+static stats_t mergeTotals;
+
+// add the counters from a file's totals record to mergeTotals
+static void addTotals(char const *totals) {
+    char key[32];
+    char const *s;
+    unsigned long long val;
+
+    for (unsigned i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        sprintf(key, "\"%s\": ", fields[i].name);
+        if ((s = strstr(totals, key)) && sscanf(s + strlen(key), "%llu", &val) == 1)
+            FIELD(&mergeTotals, i) += val;
+    }
+    if ((s = strstr(totals, "\"profiles\": ["))) {
+        s += strlen("\"profiles\": [");
+        for (int i = 0; i < STATPROFILES && sscanf(s, "%llu", &val) == 1; i++) {
+            mergeTotals.profiles[i] += val;
+            if (!(s = strpbrk(s, ",]")) || *s == ']')
+                break;
+            s++;
+        }
+    }
+}
+
+bool statsMerge(const char *batchName, const char *jsonName) {
+    FILE *fp;
+    long size;
+    char *record;
+
+    if (!(fp = fopen(jsonName, "rb")))
+        return false;
+    fseek(fp, 0, SEEK_END);
+    size   = ftell(fp);
+    record = (char *)xmalloc(size + 1);
+    fseek(fp, 0, SEEK_SET);
+    size         = (long)fread(record, 1, size, fp);
+    record[size] = '\0';
+    fclose(fp);
+    while (size > 0 && (record[size - 1] == '\n' || record[size - 1] == '\r'))
+        record[--size] = '\0';
+
+    char const *totals = strstr(record, "\"totals\": {");
+    if (totals && (jsonFp || (jsonFp = createFile(batchName)))) {
+        fputs(fileCnt++ ? ",\n" : "{\n\"files\": [\n", jsonFp);
+        fputs(record, jsonFp);
+        addTotals(totals);
+        remove(jsonName);
+    }
+    free(record);
+    return totals != NULL;
+}
+
+void statsMergeClose() {
+    static stats_t const zero;
+
+    if (!jsonFp)
+        return;
+    fputs("\n],\n\"totals\": {", jsonFp);
+    writeCounters(&mergeTotals, &zero, false);
+    fputs("}\n}\n", jsonFp);
+    fclose(jsonFp);
+    jsonFp = NULL;
+}
@@ -0,0 +1,63 @@
+/****************************************************************************
+ *  program: flux2imd - create imd image file from kryoflux file            *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#define STATPROFILES    8   // profile counts above this are merged into the last one
+
+// counters are updated in line by the modules doing the work, so keep them simple
+typedef struct {
+    uint64_t tracks;
+    uint64_t bytes;             // container bytes ingested
+    uint64_t transitions;       // flux transitions ingested
+    uint64_t dpllBits;          // bits delivered by the dpll
+    uint64_t patternTests;      // bit positions tested for an address mark
+    uint64_t crcCalls;
+    uint64_t revolutions;       // index holes starting a revolution ingested
+    uint64_t restarts;          // track decodes restarted after a sector size change
+    uint64_t dpllRetries;       // tracks retried with another dpll engine
+    uint64_t allocations;
+    uint64_t cacheHits;         // tracks loaded from the decode cache
+    uint64_t profiles[STATPROFILES];    // dpll retrains for each profile
+    uint64_t loadUs;            // wall time in microseconds
+    uint64_t decodeUs;
+    uint64_t writeUs;
+} stats_t;
+
+extern stats_t stats;
+
+uint64_t usClock();                         // wall clock in microseconds
+void statsOpen(const char *batchName);      // NULL for a sidecar per file
+void statsCsv();                            // write the flux statistics to a csv file per file
+void statsSectors();                        // write the sector quality map to a .sec.csv file per file
+void statsBeginFile(const char *fname);
+void statsEndTrack(int cyl, int head);
+void statsEndFile();
+void statsClose();
+bool statsMerge(const char *batchName, const char *jsonName);  // add a batch worker's .json file
+void statsMergeClose();
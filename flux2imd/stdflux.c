@@ -2,9 +2,12 @@
 #include <stdlib.h>
 #include "util.h"
 #include "stdflux.h"
+#include "stats.h"
 #include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 
 /*
 * flux data is stored as the time in ns since the start of the data stream. These times are adjusted to
@@ -13,10 +16,15 @@
 * the absolute values are used  to index into the index table to get further information
 */
 #define PULSECNTS   20
+#define MAXPEAKS    64      // interval peaks used for the jitter estimate
+#define RPMBAND     327.0   // measured speeds below this are from a 300 rpm drive, else 360 rpm
+#define MAXSLOPE    0.5     // limit on the relative change of the scaler across a segment
+#define RAMPMIN     0.002   // relative speed change between revolutions treated as measurement noise
 static int32_t *sfTs;            // where the samples are saved
 static uint32_t sfTsLen;         // length of the allocated array
 static double sfSclk;            // sample period in ns
 static double sfRpm;             // rotational speed (300.0 or 360.0) revolutions per minute
+static double sfFirstRpm;        // measured speed of the first revolution
 static double sfScaler;          // scaler used to convert cnts to ns with adjustments for rotational variation
 static double sfBaseNs;         // position in ns of last change of RPM actual
 static int32_t sfBaseDelta;     // cummulative delta since last change of RPM actual           
@@ -33,6 +41,25 @@ static bool sfIndexHandled;      // true if last getTs index processing is done
 static Index *sfIndex;           // always includes 1 for SODATA entry
 static uint32_t sfPulseCnt[PULSECNTS];  // used to track pulse counts in 0.5us slots
 static int32_t sfCellWidth;      // best guess at cell width in us
+static double sfIck;             // index clock of the source, 0 if not known
+static bool sfRecording;         // true if the calls building the stream are recorded
+static fluxRecord_t sfRecord;
+static uint32_t sfRecDeltaSize;
+static int sfRecEventSize;
+static fluxStats_t sfStats;
+
+// each call to setActualRPM starts a segment, normally one revolution, whose
+// samples were scaled by a single scaler. endFlux uses the neighbouring segments
+// to ramp the scaler across each one, compensating for drift within a revolution
+typedef struct {
+    uint32_t pos;       // first sample of the segment
+    double baseNs;      // ns at the start of the segment
+    double scaler;
+    double slope;       // relative change of the scaler across the segment
+} rpmSeg_t;
+static rpmSeg_t *sfSeg;
+static int sfSegCnt;
+static int sfSegLen;
 
 #ifdef _DEBUG
 uint32_t newSampleCnt;
@@ -43,11 +70,41 @@ uint16_t actIndexCnt;
 
 static uint32_t tsToPos(int32_t ts);
 
+static void recordEvent(int16_t itype, uint32_t delta, double rpm) {
+    if (sfRecord.eventCnt == sfRecEventSize) {
+        fluxEvent_t *events = (fluxEvent_t *)xmalloc((sfRecEventSize += 64) * sizeof(fluxEvent_t));
+        if (sfRecord.events) {
+            memcpy(events, sfRecord.events, sfRecord.eventCnt * sizeof(fluxEvent_t));
+            free(sfRecord.events);
+        }
+        sfRecord.events = events;
+    }
+    fluxEvent_t *p = &sfRecord.events[sfRecord.eventCnt++];
+    p->pos         = sfRecord.deltaCnt;
+    p->itype       = itype;
+    p->delta       = delta;
+    p->rpm         = rpm;
+}
+
 void beginFlux(uint32_t sampleCnt, int indexCnt, double sclk, double rpm, int16_t hsCnt) {  // indexCnt is the count of index holes
+    if (sfRecording) {
+        sfRecord.sampleCnt = sampleCnt;
+        sfRecord.indexCnt  = indexCnt;
+        sfRecord.sclk      = sclk;
+        sfRecord.rpm       = rpm;
+        sfRecord.hsCnt     = hsCnt;
+        sfRecord.deltaCnt  = 0;
+        sfRecord.eventCnt  = 0;
+    }
+    sfIck = 0.0;
+    memset(&sfStats, 0, sizeof(sfStats));
     free(sfTs);
     free(sfIndex);
+    free(sfSeg);
     sfTs = NULL;
     sfIndex = NULL;
+    sfSeg = NULL;
+    sfSegCnt = 0;
    
     if (sampleCnt + indexCnt == 0)
         return;
@@ -61,6 +118,8 @@ void beginFlux(uint32_t sampleCnt, int indexCnt, double sclk, double rpm, int16_
     sfIndex[0].itype = SODATA;
     sfIndex[0].pos = 1;
     sfIndex[0].ts = INT32_MIN;
+    sfSegLen = indexCnt + 2;                                 // one per index, plus the lead in
+    sfSeg = xmalloc(sizeof(rpmSeg_t) * sfSegLen);
 
     sfCyl = sfHead = -1;
     sfHsCnt = hsCnt;
@@ -70,6 +129,7 @@ void beginFlux(uint32_t sampleCnt, int indexCnt, double sclk, double rpm, int16_
     sfSclk = sclk;
     sfScaler = 1.0E9 / sclk;
     sfRpm = rpm;
+    sfFirstRpm = 0.0;
     sfNextIndexTs = 1;
     sfIndexHandled = false;
     memset(sfPulseCnt, 0, sizeof(sfPulseCnt));
@@ -89,9 +149,127 @@ void setCylHead(int16_t cyl, int16_t head) {
 }
 
 void setActualRPM(double rpm) {
+    if (sfRecording)
+        recordEvent(FLUXRPM, 0, rpm);
+    if (sfFirstRpm == 0.0)
+        sfFirstRpm = rpm;
+    if (sfStats.rpmCnt < FLUXREVS)
+        sfStats.rpm[sfStats.rpmCnt] = rpm;
+    sfStats.meanRpm += rpm;         // converted to the mean in endFlux
+    if (sfStats.rpmCnt++ == 0 || rpm < sfStats.minRpm)
+        sfStats.minRpm = rpm;
+    if (rpm > sfStats.maxRpm)
+        sfStats.maxRpm = rpm;
     sfBaseNs += (sfBaseDelta * sfScaler);
     sfBaseDelta = 0;
-    sfScaler = 1.0E9 / sfSclk * sfRpm / rpm;
+    // a revolution at the measured speed is mapped to one at the nominal speed
+    sfScaler = 1.0E9 / sfSclk * rpm / sfRpm;
+
+    if (sfSegCnt && sfSeg[sfSegCnt - 1].pos == sfTsPos)    // no samples at the old speed
+        sfSegCnt--;
+    if (sfSegCnt < sfSegLen) {
+        sfSeg[sfSegCnt].pos = sfTsPos;
+        sfSeg[sfSegCnt].baseNs = sfBaseNs;
+        sfSeg[sfSegCnt++].scaler = sfScaler;
+    }
+}
+
+// picks the nominal speed of the drive from the median of the measured revolutions
+// so a single slow or fast revolution does not mis-scale the whole track
+double nominalRPM(const double *rpm, int cnt) {
+    double sorted[FLUXREVS];
+    int n = 0;
+
+    for (int i = 0; i < cnt && n < FLUXREVS; i++) {
+        if (rpm[i] > 0.0) {
+            int j;
+            for (j = n++; j > 0 && sorted[j - 1] > rpm[i]; j--)
+                sorted[j] = sorted[j - 1];
+            sorted[j] = rpm[i];
+        }
+    }
+    if (n == 0)
+        return 300.0;
+    double median = n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+    return median < RPMBAND ? 300.0 : 360.0;
+}
+
+// accumulate the interval statistics for the sample at pos
+static void addInterval(uint32_t pos) {
+    int32_t interval = sfTs[pos] - (pos > 1 ? sfTs[pos - 1] : 0);
+    uint32_t slot    = interval > 0 ? (interval + FLUXHISTNS / 2) / FLUXHISTNS : 0;
+    sfStats.hist[slot < FLUXHISTSLOTS ? slot : FLUXHISTSLOTS - 1]++;
+    if (interval > sfStats.maxInterval)
+        sfStats.maxInterval = interval;
+    sfStats.samples++;
+    if (pos > 1) {
+        int32_t halfusDelta = (interval + 250) / 500;
+        if (halfusDelta < PULSECNTS)
+            sfPulseCnt[halfusDelta]++;
+    }
+}
+
+// map ts within the segment starting at baseNs, assuming the scaler changes linearly across it by slope
+static int32_t rampTs(int32_t ts, double baseNs, double len, double slope) {
+    double u = (ts - baseNs) / len;
+    return (int32_t)(ts + slope * len / 2 * u * (u - 1.0));
+}
+
+// replaces the constant scaler of each segment with one that ramps through it, with the
+// slope taken from the neighbouring segments. The mean scaler, and so the time for the
+// segment, is unchanged, only the samples within it move. Nothing is done unless the
+// speed changes between segments by more than the measurement noise, in which case the
+// ingest time interval statistics are left as they are
+static void compensateDrift() {
+    if (sfSegCnt < 2)
+        return;
+    int seg;
+    for (seg = 1; seg < sfSegCnt; seg++)
+        if (fabs(sfSeg[seg].scaler - sfSeg[seg - 1].scaler) > sfSeg[seg - 1].scaler * RAMPMIN)
+            break;
+    if (seg == sfSegCnt)
+        return;
+
+    double endNs = sfBaseNs + sfBaseDelta * sfScaler;
+    for (int i = 0; i < sfSegCnt; i++) {
+        double len = (i + 1 < sfSegCnt ? sfSeg[i + 1].baseNs : endNs) - sfSeg[i].baseNs;
+        int lo = i > 0 ? i - 1 : i;
+        int hi = i + 1 < sfSegCnt ? i + 1 : i;
+        double loMid = (sfSeg[lo].baseNs + (lo + 1 < sfSegCnt ? sfSeg[lo + 1].baseNs : endNs)) / 2;
+        double hiMid = (sfSeg[hi].baseNs + (hi + 1 < sfSegCnt ? sfSeg[hi + 1].baseNs : endNs)) / 2;
+        double slope = hiMid > loMid ? (sfSeg[hi].scaler - sfSeg[lo].scaler) / (hiMid - loMid) * len / sfSeg[i].scaler : 0.0;
+        sfSeg[i].slope = slope > MAXSLOPE ? MAXSLOPE : slope < -MAXSLOPE ? -MAXSLOPE : slope;
+    }
+
+    // the interval statistics are rebuilt from the compensated samples in the same pass
+    memset(sfStats.hist, 0, sizeof(sfStats.hist));
+    memset(sfPulseCnt, 0, sizeof(sfPulseCnt));
+    sfStats.maxInterval = 0;
+    sfStats.samples = 0;
+    seg = 0;
+    double len = (sfSegCnt > 1 ? sfSeg[1].baseNs : endNs) - sfSeg[0].baseNs;
+    for (uint32_t pos = 0; pos < sfTsLen; pos++) {
+        while (seg + 1 < sfSegCnt && pos >= sfSeg[seg + 1].pos) {
+            seg++;
+            len = (seg + 1 < sfSegCnt ? sfSeg[seg + 1].baseNs : endNs) - sfSeg[seg].baseNs;
+        }
+        if (pos >= sfSeg[seg].pos && sfSeg[seg].slope != 0.0 && len > 0.0)
+            sfTs[pos] = rampTs(sfTs[pos], sfSeg[seg].baseNs, len, sfSeg[seg].slope);
+        addInterval(pos);
+    }
+
+    // indexes keep their place relative to the samples
+    for (int j = 0; j < sfIndexPos; j++) {
+        int32_t ts = sfIndex[j].ts;
+        if (ts < 0)
+            continue;
+        int i;
+        for (i = sfSegCnt - 1; i > 0 && ts < sfSeg[i].baseNs; i--)
+            ;
+        double len = (i + 1 < sfSegCnt ? sfSeg[i + 1].baseNs : endNs) - sfSeg[i].baseNs;
+        if (ts >= sfSeg[i].baseNs && ts <= sfSeg[i].baseNs + len && len > 0.0)
+            sfIndex[j].ts = rampTs(ts, sfSeg[i].baseNs, len, sfSeg[i].slope);
+    }
 }
 
 
@@ -99,15 +277,22 @@ void addDelta(uint32_t delta) {
 #ifdef _DEBUG
     actSampleCnt++;
 #endif
+    stats.transitions++;
+    if (sfRecording) {
+        if (sfRecord.deltaCnt == sfRecDeltaSize) {
+            uint32_t *deltas = (uint32_t *)xmalloc((sfRecDeltaSize += 64 * 1024) * sizeof(uint32_t));
+            if (sfRecord.deltas) {
+                memcpy(deltas, sfRecord.deltas, sfRecord.deltaCnt * sizeof(uint32_t));
+                free(sfRecord.deltas);
+            }
+            sfRecord.deltas = deltas;
+        }
+        sfRecord.deltas[sfRecord.deltaCnt++] = delta;
+    }
     sfBaseDelta += delta;
     if (sfTsPos < sfTsLen) {
         sfTs[sfTsPos] = (int32_t)(sfBaseNs + sfBaseDelta * sfScaler);
-        if (sfTsPos > 1) {
-            int32_t halfusDelta = (sfTs[sfTsPos] - sfTs[sfTsPos - 1] + 250) / 500;
-            if (halfusDelta < PULSECNTS)
-                sfPulseCnt[halfusDelta]++;
-        }
-        sfTsPos++;
+        addInterval(sfTsPos++);
     } else
         logFull(D_ERROR, "addTs out of bounds\n");
 };
@@ -117,6 +302,10 @@ void addIndex(int16_t itype, uint32_t delta) {
 #ifdef _DEBUG
     actIndexCnt++;
 #endif
+    if (sfRecording)
+        recordEvent(itype, delta, 0.0);
+    if (itype == SSSTART || itype == HSSTART)
+        stats.revolutions++;
     if (sfIndexPos == 1 && sfTsPos == 1 && itype < 1)                  // if start of track or sector 0 before data no need for SODATA index
         sfIndexPos = 0;
 
@@ -144,7 +333,8 @@ void endFlux() {
     sfTsLen = sfTsPos;        // correct any variance for SCP files with 0 counts merged.
     sfIndex[sfIndexPos].ts = sfTs[sfTsLen] = INT32_MAX;
 
-    
+    compensateDrift();
+
     // work out the most likely cell width by looking for the largest value of
     // count of pulse width + pulse width * 2
     uint32_t largestCnt = 0;
@@ -153,6 +343,32 @@ void endFlux() {
             largestCnt = sfPulseCnt[i] + sfPulseCnt[i * 2];
             sfCellWidth = i * 500;
         }
+
+    // the intervals are grouped into peaks at multiples of half the cell width
+    // and the jitter is the pooled standard deviation about the peak centres
+    double cnt[MAXPEAKS] = { 0 }, sum[MAXPEAKS] = { 0 }, sumSq[MAXPEAKS] = { 0 };
+    int32_t grid = sfCellWidth / 2;
+    for (int i = 0; i < FLUXHISTSLOTS - 1; i++) {
+        int peak = (i * FLUXHISTNS + grid / 2) / grid;
+        if (sfStats.hist[i] && peak < MAXPEAKS) {
+            double ns = (double)i * FLUXHISTNS;
+            cnt[peak] += sfStats.hist[i];
+            sum[peak] += ns * sfStats.hist[i];
+            sumSq[peak] += ns * ns * sfStats.hist[i];
+        }
+    }
+    double total = 0.0, var = 0.0;
+    for (int i = 0; i < MAXPEAKS; i++)
+        if (cnt[i]) {
+            total += cnt[i];
+            var += sumSq[i] - sum[i] * sum[i] / cnt[i];
+        }
+    sfStats.jitter    = total > 0.0 && var > 0.0 ? sqrt(var / total) : 0.0;
+    sfStats.cellWidth = sfCellWidth;
+    if (sfStats.rpmCnt) {
+        sfStats.meanRpm /= sfStats.rpmCnt;
+        sfStats.drift = (sfStats.maxRpm - sfStats.minRpm) * 100.0 / sfStats.meanRpm;
+    }
 }
 
 
@@ -228,6 +444,10 @@ double getRPM() {
     return sfRpm;
 }
 
+double getMeasuredRPM() {
+    return sfFirstRpm;
+}
+
 int16_t getCyl() {
     return sfCyl;
 }
@@ -239,3 +459,38 @@ int16_t getCellWidth() {
  //   printf("Cell Width %d\n", sfCellWidth);
     return sfCellWidth;
 }
+
+// hash of the flux stream, used to identify unchanged tracks
+uint64_t fluxHash() {
+    uint64_t hash = 0xcbf29ce484222325;         // FNV-1a, applied to 32 bit words
+
+    hash = (hash ^ (uint16_t)sfHsCnt) * 0x100000001b3;
+    for (uint32_t i = 0; i < sfTsLen; i++)
+        hash = (hash ^ (uint32_t)sfTs[i]) * 0x100000001b3;
+    for (int i = 0; i < sfIndexPos; i++) {
+        hash = (hash ^ (uint32_t)sfIndex[i].ts) * 0x100000001b3;
+        hash = (hash ^ ((sfIndex[i].pos << 16) ^ (uint16_t)sfIndex[i].itype)) * 0x100000001b3;
+    }
+    return hash;
+}
+
+void setIndexClock(double ick) {
+    sfIck = ick;
+}
+
+double getIndexClock() {
+    return sfIck;
+}
+
+// when enabled the calls that build each flux stream are recorded, so the stream can be saved and replayed
+void recordFlux(bool enable) {
+    sfRecording = enable;
+}
+
+const fluxRecord_t *getFluxRecord() {
+    return &sfRecord;
+}
+
+const fluxStats_t *getFluxStats() {
+    return &sfStats;
+}
@@ -21,10 +21,51 @@ typedef struct {
 
 typedef bool (*OnIndex)(int16_t itype);
 
+// a recorded call to addIndex or, for itype FLUXRPM, setActualRPM
+#define FLUXRPM     INT16_MAX
+typedef struct {
+    uint32_t pos;       // samples added before the call
+    int16_t itype;
+    uint32_t delta;
+    double rpm;
+} fluxEvent_t;
+
+// the calls that built a flux stream
+typedef struct {
+    uint32_t sampleCnt; // beginFlux arguments
+    int indexCnt;
+    double sclk;
+    double rpm;
+    int16_t hsCnt;
+    uint32_t deltaCnt;  // addDelta arguments
+    uint32_t *deltas;
+    int eventCnt;
+    fluxEvent_t *events;
+} fluxRecord_t;
+
+// statistics gathered as the flux stream is built
+#define FLUXHISTNS      25      // ns per histogram slot
+#define FLUXHISTSLOTS   512     // the last slot also counts longer intervals
+#define FLUXREVS        64      // revolutions whose rpm is kept
+typedef struct {
+    uint32_t hist[FLUXHISTSLOTS];   // intervals rounded to the nearest slot
+    uint32_t samples;
+    int32_t maxInterval;            // ns
+    int32_t cellWidth;              // ns
+    double jitter;                  // rms deviation in ns of intervals from the centre of their peak
+    int rpmCnt;                     // count of measured rpms, normally one per revolution
+    double rpm[FLUXREVS];
+    double minRpm;
+    double maxRpm;
+    double meanRpm;
+    double drift;                   // (maxRpm - minRpm) / meanRpm as a percentage
+} fluxStats_t;
+
 
 
 void beginFlux(uint32_t sampleCnt, int indexCnt, double sclk, double rpm, int16_t hsCnt);  // indexCnt should include index holes + 1 for EODATA. SODATA allocated internally
 void setActualRPM(double rpm);
+double nominalRPM(const double *rpm, int cnt);   // 300.0 or 360.0 from the median of the measured speeds
 void addDelta(uint32_t delta);
 void addIndex(int16_t itype, uint32_t delta);
 void endFlux();
@@ -36,8 +77,15 @@ int32_t peekTs();
 int32_t getTs();
 uint16_t getHsCnt();
 double getRPM();
+double getMeasuredRPM();                      // speed of the first revolution
 OnIndex setOnIndex(OnIndex pfunc);
 int16_t getCyl();
 int16_t getHead();
 void setCylHead(int16_t cyl, int16_t head);
+uint64_t fluxHash();
+void setIndexClock(double ick);
+double getIndexClock();
+void recordFlux(bool enable);
+const fluxRecord_t *getFluxRecord();
+const fluxStats_t *getFluxStats();
 int16_t getCellWidth();
\ No newline at end of file
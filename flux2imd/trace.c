@@ -0,0 +1,123 @@
+/****************************************************************************
+ *  program: flux2imd - create imd image file from kryoflux file            *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dpll.h"
+#include "formats.h"
+#include "trace.h"
+#include "util.h"
+#ifdef __GNUC__
+#include <limits.h>
+#define _MAX_PATH PATH_MAX
+#endif
+
+/*
+    records are collected in a ring buffer which is written to the trace file each time it fills
+    and when the file is closed, so the cost of tracing each bit is a copy of the dpll state
+*/
+#define RINGSIZE    65536
+
+int traceLevel;
+static FILE *traceFp;
+static traceRec_t *ring;
+static unsigned ringPos;
+
+static void flushRing() {
+    if (ringPos && fwrite(ring, sizeof(traceRec_t), ringPos, traceFp) != ringPos) {
+        logFull(D_ERROR, "trace file write failed, tracing stopped\n");
+        fclose(traceFp);
+        traceFp = NULL;
+    }
+    ringPos = 0;
+}
+
+static traceRec_t *nextRec(uint8_t type) {
+    if (ringPos == RINGSIZE)
+        flushRing();
+    traceRec_t *p = &ring[ringPos++];
+    memset(p, 0, sizeof(traceRec_t));
+    p->type = type;
+    return p;
+}
+
+void traceOpen(const char *fname) {
+    char traceFile[_MAX_PATH + 1];
+    uint16_t hdr[2] = { TRACEVERSION, sizeof(traceRec_t) };
+
+    if (traceLevel == TRACE_OFF)
+        return;
+    strcpy(traceFile, fname);
+    char *s = strrchr(traceFile, '.');
+    strcpy(s && !strpbrk(s, "/\\") ? s : strchr(traceFile, 0), ".trc");
+    if ((traceFp = fopen(traceFile, "wb")) == NULL) {
+        logFull(D_ERROR, "cannot create %s\n", traceFile);
+        return;
+    }
+    if (!ring)
+        ring = (traceRec_t *)xmalloc(RINGSIZE * sizeof(traceRec_t));
+    ringPos = 0;
+    fwrite(TRACEMAGIC, 1, 8, traceFp);
+    fwrite(hdr, sizeof(hdr), 1, traceFp);
+}
+
+void traceClose() {
+    if (traceFp) {
+        flushRing();
+        if (traceFp)
+            fclose(traceFp);
+        traceFp = NULL;
+    }
+}
+
+void traceTrack(int cyl, int head) {
+    if (traceFp) {
+        traceRec_t *p = nextRec(TR_TRACK);
+        p->bitPos     = cyl;
+        p->cellSize   = head;
+    }
+}
+
+void traceBlock(int profile) {
+    if (traceFp) {
+        traceRec_t *p = nextRec(TR_BLOCK);
+        p->bitPos     = profile;
+        p->cellSize   = curFormat->nominalCellSize;
+        p->am         = curFormat->encoding;
+    }
+}
+
+void traceBit(uint16_t am) {
+    if (traceFp) {
+        traceRec_t *p = nextRec(am ? TR_MATCH : TR_BIT);
+        p->pattern    = pattern;
+        p->bitPos     = getBitCnt(0);
+        p->am         = am;
+        p->bits65_66  = (uint8_t)bits65_66;
+        dpllState(&p->cellSize, &p->phase);
+    }
+}
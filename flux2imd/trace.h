@@ -0,0 +1,62 @@
+/****************************************************************************
+ *  program: flux2imd - create imd image file from kryoflux file            *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+    binary trace of the dpll and address mark matcher
+    the file starts with TRACEMAGIC, a version and the record size, followed by the records
+    in native byte order
+*/
+#define TRACEMAGIC      "F2ITRACE"
+#define TRACEVERSION    1
+
+enum { TRACE_OFF = 0, TRACE_MATCH, TRACE_ALL };     // trace levels
+enum { TR_BIT = 0, TR_MATCH, TR_TRACK, TR_BLOCK };  // record types
+
+typedef struct {
+    uint64_t pattern;       // last 64 half bits from the dpll
+    uint32_t bitPos;        // bit position from the start of the flux stream
+    uint16_t cellSize;      // dpll cell width in ns
+    uint16_t am;            // address mark matched
+    uint8_t phase;          // position of the last transition in the cell, in 16ths
+    uint8_t type;
+    uint8_t bits65_66;      // the two bits before pattern
+    uint8_t spare[5];
+} traceRec_t;
+
+// TR_TRACK records hold the cylinder in bitPos and head in cellSize
+// TR_BLOCK records hold the dpll profile in bitPos, the nominal cell size in cellSize and encoding in am
+
+extern int traceLevel;
+
+void traceOpen(const char *fname);
+void traceClose();
+void traceTrack(int cyl, int head);
+void traceBlock(int profile);
+void traceBit(uint16_t am);
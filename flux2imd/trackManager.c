@@ -26,10 +26,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include "flux.h"
 #include "trackManager.h"
 #include "sectorManager.h"
+#include "stats.h"
 #include "util.h"
 
 int maxHead = -1;
@@ -38,6 +40,126 @@ static track_t *disk[MAXCYLINDER][2];                  // two sided disk
 static bool trackLog[MAXCYLINDER][2];
 
 track_t* trackPtr = NULL;
+int captureId;
+
+/*
+ * all track and sector data is allocated from simple arenas, one per track
+ * nothing is freed individually, instead a track's arena is released in one
+ * go once the track has been written, or all of them by removeDisk.
+ * Released blocks are kept for reuse and one is kept for the next disk
+ */
+#define ARENABLOCK  (16 * 1024)
+#define ARENAALIGN  8
+
+typedef struct _arenaBlock {
+    struct _arenaBlock *next;
+    size_t size;
+    size_t used;
+    uint64_t mem[];                 // uint64_t to align the allocations
+} arenaBlock_t;
+
+static arenaBlock_t *arenas[MAXCYLINDER][2];
+static arenaBlock_t **curArena;         // the arena of the track being decoded
+static arenaBlock_t *keptArena;         // summaries of released tracks
+static arenaBlock_t *freeBlocks;
+static struct {
+    unsigned allocs;
+    unsigned blocks;
+    size_t bytes;
+    unsigned spills;
+} arenaStats;
+
+/*
+ * optional memory budget for the track data. Once the arena blocks held exceed it, the
+ * copies of bad sectors kept are capped and finished tracks are spilled to a temporary
+ * file, leaving only their summary. Spilled tracks are read back when they are written
+ */
+static size_t budget;                   // 0 if unlimited
+static size_t heldBytes;                // in arena blocks, including free ones
+static FILE *spillFp;
+static bool noSpill;                    // the spill file could not be created
+static long spillPos[MAXCYLINDER][2];   // valid if the track has TS_SPILLED set
+
+static void *arenaAlloc(arenaBlock_t **chain, size_t size) {
+    size = (size + ARENAALIGN - 1) & ~(size_t)(ARENAALIGN - 1);
+    if (!*chain || (*chain)->used + size > (*chain)->size) {
+        arenaBlock_t *p;
+        if (size <= ARENABLOCK && freeBlocks) {
+            p          = freeBlocks;
+            freeBlocks = p->next;
+        } else {
+            size_t blockSize = size > ARENABLOCK ? size : ARENABLOCK;
+            p                = (arenaBlock_t *)xmalloc(sizeof(arenaBlock_t) + blockSize);
+            p->size          = blockSize;
+            heldBytes += blockSize;
+            arenaStats.blocks++;
+        }
+        p->used = 0;
+        p->next = *chain;
+        *chain  = p;
+    }
+    void *ptr = (uint8_t *)(*chain)->mem + (*chain)->used;
+    (*chain)->used += size;
+    return ptr;
+}
+
+// only new track data is counted, not summaries or tracks read back from the spill file
+void *diskAlloc(size_t size) {
+    assert(curArena);
+    stats.allocations++;
+    arenaStats.allocs++;
+    arenaStats.bytes += size;
+    return arenaAlloc(curArena, size);
+}
+
+// return the blocks of an arena to the free list
+static void freeArena(arenaBlock_t **chain) {
+    while (*chain) {
+        arenaBlock_t *p = *chain;
+        *chain          = p->next;
+        if (p->size == ARENABLOCK) {
+            p->next    = freeBlocks;
+            freeBlocks = p;
+        } else {
+            heldBytes -= p->size;
+            free(p);
+        }
+    }
+}
+
+static void trimFreeBlocks(unsigned keep) {
+    arenaBlock_t **q = &freeBlocks;
+    while (*q && keep--)
+        q = &(*q)->next;
+    while (*q) {
+        arenaBlock_t *p = *q;
+        *q              = p->next;
+        heldBytes -= p->size;
+        free(p);
+    }
+}
+
+static void resetArena() {
+    DBGLOG(D_DECODER, "Track data: %u allocations, %uK in %u arena block%s\n", arenaStats.allocs,
+           (unsigned)((arenaStats.bytes + 1023) / 1024), arenaStats.blocks, arenaStats.blocks == 1 ? "" : "s");
+    if (arenaStats.spills)
+        logFull(ALWAYS, "Memory budget exceeded, %u track%s spilled to disk\n", arenaStats.spills,
+                arenaStats.spills == 1 ? "" : "s");
+    memset(&arenaStats, 0, sizeof(arenaStats));
+
+    for (int cyl = 0; cyl < MAXCYLINDER; cyl++)
+        for (int head = 0; head < 2; head++)
+            freeArena(&arenas[cyl][head]);
+    freeArena(&keptArena);
+    curArena = NULL;
+    trimFreeBlocks(1);                  // keep only one block
+    if (freeBlocks)
+        arenaStats.blocks = 1;
+    if (spillFp)
+        fclose(spillFp);                // a tmpfile so it is removed
+    spillFp = NULL;
+    noSpill = false;
+}
 
 
 static void buildInterleaveMap(uint8_t *interleaveMap, int interleave, int spt) {
@@ -100,17 +222,6 @@ static void fixSectorMap() {
     }
 }
 
-static void removeTrack(track_t* p) {
-    if (p) {
-        for (int i = 0; i < p->fmt->spt; i++) {
-            removeSectorData(p->sectors[i].sectorDataList);
-            p->sectors[i].sectorDataList = NULL;
-        }
-        if (p == trackPtr)
-            trackPtr = NULL;
-        free(p);
-    }
-}
 
 
 
@@ -120,6 +231,26 @@ bool checkTrack(int profile) {
     assert(trackPtr);
     if (debug & D_NOOPTIMISE)
         return false;
+    return isTrackGood();
+}
+
+// voted and corrected sectors pass the crc check but were not read as such
+static bool isEstimated(sector_t const *p) {
+    return (p->status & (SS_VOTED | SS_CORRECTED)) != 0;
+}
+
+// true if the track has been decoded with all sectors read good, so later captures add nothing
+bool isTrackComplete(int cylinder, int head) {
+    track_t *pTrack = getTrack(cylinder, head);
+    if (!pTrack)
+        return false;
+    for (int i = 0; i < pTrack->fmt->spt; i++)
+        if ((pTrack->sectors[i].status & SS_GOOD) != SS_GOOD || isEstimated(&pTrack->sectors[i]))
+            return false;
+    return true;
+}
+
+bool isTrackGood() {
     for (int i = 0; i < trackPtr->fmt->spt; i++)
         if ((trackPtr->sectors[i].status & SS_GOOD) != SS_GOOD)
             return false;
@@ -151,15 +282,16 @@ void initTrack(int cylinder, int head) {
     if (cylinder >= MAXCYLINDER || head > 1)
         logFull(D_FATAL, "Track %02u/%u exceeds program limits\n", cylinder, head);
 
-    removeTrack(disk[cylinder][head]);     // clean out any pre-existing track data
-    
-
-    trackPtr = disk[cylinder][head] = (track_t*)xmalloc(sizeof(track_t) + sizeof(sector_t) * curFormat->spt);
+    // any pre-existing track data is left in the track's arena until it is released
+    curArena = &arenas[cylinder][head];
+    trackPtr = disk[cylinder][head] = (track_t*)diskAlloc(sizeof(track_t) + sizeof(sector_t) * curFormat->spt);
     memset(trackPtr, 0, sizeof(*trackPtr) + sizeof(sector_t) * curFormat->spt);
     memset(trackPtr->slotToSector, 0xff, curFormat->spt);
     trackPtr->altCylinder = trackPtr->cylinder = cylinder;
     trackPtr->altSide = trackPtr->side = head;
     trackPtr->fmt = curFormat;
+    for (int i = 0; i < curFormat->spt; i++)
+        trackPtr->sectors[i].capture = (uint8_t)captureId;
 }
 
 void logCylHead(int cylinder, int head) {
@@ -171,13 +303,204 @@ void logCylHead(int cylinder, int head) {
         trackLog[cylinder][head] = true;
 }
 
+/*
+ * once a track has been written its sector data is no longer needed, so its arena
+ * is released, keeping only a summary of the track and sector status for the defect map
+ */
+void releaseTrack(int cylinder, int head) {
+    track_t *pTrack = getTrack(cylinder, head);
+    if (!pTrack || (pTrack->status & TS_RELEASED))
+        return;
+    size_t size      = sizeof(track_t) + sizeof(sector_t) * pTrack->fmt->spt;
+    track_t *summary = (track_t *)arenaAlloc(&keptArena, size);
+    memcpy(summary, pTrack, size);
+    for (int i = 0; i < summary->fmt->spt; i++)
+        summary->sectors[i].sectorDataList = NULL;
+    summary->status |= TS_RELEASED;
+    if (trackPtr == pTrack)
+        trackPtr = summary;
+    disk[cylinder][head] = summary;
+    if (curArena == &arenas[cylinder][head])
+        curArena = NULL;
+    freeArena(&arenas[cylinder][head]);
+}
 
-void removeDisk() {
-    for (int i = 0; i < MAXCYLINDER; i++) {
-        removeTrack(disk[i][0]);
-        removeTrack(disk[i][1]);
-        disk[i][0] = disk[i][1] = NULL;
+
+/*
+ * the spill file holds the track as is, pointers are fixed up when it is read back,
+ * followed for each sector by its count of data copies and each copy's length,
+ * suspect flag, data and any suspect bitmap, the same layout as the decode cache
+ */
+static void spillTrack(int cylinder, int head) {
+    track_t *pTrack = getTrack(cylinder, head);
+    if (!pTrack || (pTrack->status & TS_RELEASED))
+        return;
+    if (!(pTrack->status & TS_SPILLED)) {        // spilled before and not changed since
+        size_t size = sizeof(track_t) + sizeof(sector_t) * pTrack->fmt->spt;
+        fseek(spillFp, 0, SEEK_END);
+        spillPos[cylinder][head] = ftell(spillFp);
+        fwrite(pTrack, size, 1, spillFp);
+        for (int slot = 0; slot < pTrack->fmt->spt; slot++) {
+            uint32_t cnt = 0;
+            for (sectorDataList_t *q = pTrack->sectors[slot].sectorDataList; q; q = q->next)
+                cnt++;
+            fwrite(&cnt, sizeof(cnt), 1, spillFp);
+            for (sectorDataList_t *q = pTrack->sectors[slot].sectorDataList; q; q = q->next) {
+                uint32_t len       = q->sectorData.len;
+                uint8_t hasSuspect = q->sectorData.suspect != NULL;
+                fwrite(&len, sizeof(len), 1, spillFp);
+                fwrite(&hasSuspect, 1, 1, spillFp);
+                fwrite(q->sectorData.data, 1, len + (hasSuspect ? (len + 7) / 8 : 0), spillFp);
+            }
+        }
+        if (ferror(spillFp)) {
+            logFull(D_WARNING, "Cannot write to the spill file, tracks are kept in memory\n");
+            fclose(spillFp);
+            spillFp = NULL;
+            noSpill = true;
+            return;
+        }
+        pTrack->status |= TS_SPILLED;
+        arenaStats.spills++;
     }
+    releaseTrack(cylinder, head);
+}
+
+/*
+ * reads a spilled track back into its arena, returns true if it was restored so the
+ * caller can release it again once done. Tracks that are not spilled are left as is
+ */
+bool restoreTrack(int cylinder, int head) {
+    track_t *summary = getTrack(cylinder, head);
+    if (!summary || (summary->status & (TS_RELEASED | TS_SPILLED)) != (TS_RELEASED | TS_SPILLED) || !spillFp)
+        return false;
+    size_t size     = sizeof(track_t) + sizeof(sector_t) * summary->fmt->spt;
+    track_t *pTrack = (track_t *)arenaAlloc(&arenas[cylinder][head], size);
+    fseek(spillFp, spillPos[cylinder][head], SEEK_SET);
+    bool ok = fread(pTrack, size, 1, spillFp) == 1;
+    for (int slot = 0; ok && slot < pTrack->fmt->spt; slot++) {
+        sectorDataList_t **tail = &pTrack->sectors[slot].sectorDataList;
+        uint32_t cnt;
+        ok = fread(&cnt, sizeof(cnt), 1, spillFp) == 1;
+        for (uint32_t i = 0; ok && i < cnt; i++) {
+            uint32_t len;
+            uint8_t hasSuspect;
+            ok = fread(&len, sizeof(len), 1, spillFp) == 1 && fread(&hasSuspect, 1, 1, spillFp) == 1;
+            if (ok) {
+                unsigned extra        = hasSuspect ? (len + 7) / 8 : 0;
+                sectorDataList_t *q   = (sectorDataList_t *)arenaAlloc(&arenas[cylinder][head], sizeof(sectorDataList_t) + len + extra);
+                q->sectorData.len     = len;
+                q->sectorData.suspect = hasSuspect ? q->sectorData.data + len : NULL;
+                ok                    = fread(q->sectorData.data, 1, len + extra, spillFp) == len + extra;
+                *tail                 = q;
+                tail                  = &q->next;
+            }
+        }
+        *tail = NULL;
+    }
+    if (!ok) {
+        logFull(D_ERROR, "Cannot read track %02d/%d back from the spill file\n", cylinder, head);
+        freeArena(&arenas[cylinder][head]);
+        return false;
+    }
+    pTrack->status = summary->status & ~TS_RELEASED;
+    if (trackPtr == summary)
+        trackPtr = pTrack;
+    disk[cylinder][head] = pTrack;
+    return true;
+}
+
+bool isOverBudget() {
+    return budget && heldBytes > budget;
+}
+
+/*
+ * called once a track is finished. If the track data held exceeds the budget, the spare
+ * arena blocks are freed and if still over, all the finished tracks are spilled to disk
+ */
+void enforceBudget() {
+    if (!isOverBudget())
+        return;
+    trimFreeBlocks(0);
+    if (!isOverBudget() || noSpill)
+        return;
+    if (!spillFp && !(spillFp = tmpfile())) {
+        logFull(D_WARNING, "Cannot create spill file, only the bad sector copies kept are limited\n");
+        noSpill = true;
+        return;
+    }
+    for (int cyl = 0; cyl <= maxCylinder && spillFp; cyl++)
+        for (int head = 0; head <= maxHead; head++)
+            spillTrack(cyl, head);
+    trimFreeBlocks(0);
+}
+
+void setMemoryBudget(size_t bytes) {
+    budget = bytes;
+}
+
+
+/*
+ * when fusing captures, prev is the decode of the track from earlier captures. Its good
+ * sectors replace the current track's sectors that are not good, or were only voted or
+ * corrected, matching them on the sector id, or the same slot if the current track has
+ * no id for it. A sector read good is preferred to a voted or corrected one. prev's sector data
+ * is in the same arena so it is shared rather than copied.
+ * If the format differs, the track with more good sectors is kept
+ */
+void mergeTrack(track_t const *prev) {
+    track_t *cur = trackPtr;
+    if (!prev || !cur || prev == cur || (prev->status & TS_RELEASED))
+        return;
+    if (prev->fmt != cur->fmt) {
+        logFull(D_WARNING, "Format %s differs from %s in earlier captures\n", cur->fmt->name, prev->fmt->name);
+        if (prev->cntGoodData > cur->cntGoodData)
+            trackPtr = disk[prev->cylinder][prev->side] = (track_t *)prev;
+        return;
+    }
+    bool any = false;
+    for (int i = 0; i < prev->fmt->spt; i++) {
+        if (!(prev->sectors[i].status & SS_DATAGOOD))
+            continue;
+        int slot;
+        for (slot = 0; slot < cur->fmt->spt && cur->slotToSector[slot] != prev->slotToSector[i]; slot++)
+            ;
+        if (slot == cur->fmt->spt || prev->slotToSector[i] == 0xff) {
+            if (cur->slotToSector[i] != 0xff)
+                continue;
+            slot = i;
+        }
+        sector_t *p       = &cur->sectors[slot];
+        sector_t const *q = &prev->sectors[i];
+        // a sector read good replaces a voted or corrected one, provided its idam is as good
+        bool isBetter = isEstimated(p) && !isEstimated(q) && ((q->status & SS_IDAMGOOD) || !(p->status & SS_IDAMGOOD));
+        if (!isBetter && ((p->status & SS_GOOD) == SS_GOOD || ((p->status & SS_DATAGOOD) && !(q->status & SS_IDAMGOOD))))
+            continue;
+        if (!any)
+            logFull(ALWAYS, "Filled from earlier captures Slot(Sector/capture):");
+        any = true;
+        logBasic(" %d(%d/%d)", slot, prev->slotToSector[i], prev->sectors[i].capture + 1);
+        if (!(p->status & SS_DATAGOOD))
+            cur->cntGoodData++;
+        if (!(p->status & SS_DATAGOOD) && !p->sectorDataList)
+            cur->cntAnyData++;
+        if (!(p->status & SS_IDAMGOOD) && (prev->sectors[i].status & SS_IDAMGOOD))
+            cur->cntGoodIdam++;
+        if (p->status & SS_CORRECTED)
+            cur->cntCorrected--;
+        if (prev->sectors[i].status & SS_CORRECTED)
+            cur->cntCorrected++;
+        *p                      = prev->sectors[i];
+        cur->slotToSector[slot] = prev->slotToSector[i];
+    }
+    if (any)
+        logBasic("\n");
+}
+
+void removeDisk() {
+    memset(disk, 0, sizeof(disk));
+    trackPtr = NULL;
+    resetArena();
     memset(trackLog, false, sizeof(trackLog));
     maxCylinder = -1;
     maxHead = -1;
@@ -190,6 +513,107 @@ void updateTrackFmt() {
     trackPtr->fmt = curFormat;
 }
 
+/*
+ * for sectors with only bad data, build a new copy by a per byte majority vote across
+ * all the copies seen, where bytes without the SUSPECT flag carry twice the weight.
+ * If chkData confirms the crc of the voted copy it is added as the good data.
+ * Sectors are only revoted when new copies have been added
+ * returns true if any sector was recovered
+ */
+#define MAXVOTELEN  (1024 + 16)
+
+bool voteSectors(bool (*chkData)(int slot, uint16_t *data, unsigned len)) {
+    uint16_t voted[MAXVOTELEN];
+    sectorDataList_t *copies[64];
+    bool recovered = false;
+
+    assert(trackPtr);
+    for (int slot = 0; slot < trackPtr->fmt->spt; slot++) {
+        sector_t *p = &trackPtr->sectors[slot];
+        if ((p->status & SS_DATAGOOD) || !p->sectorDataList)
+            continue;
+
+        unsigned len = p->sectorDataList->sectorData.len;
+        unsigned cnt = 0;
+        for (sectorDataList_t *q = p->sectorDataList; q && cnt < sizeof(copies) / sizeof(copies[0]); q = q->next)
+            if (q->sectorData.len == len)
+                copies[cnt++] = q;
+        if (cnt < 2 || cnt == p->voteCnt || len > MAXVOTELEN)
+            continue;
+        p->voteCnt = cnt;
+
+        for (unsigned i = 0; i < len; i++) {
+            int bestWeight = 0;
+            for (unsigned j = 0; j < cnt; j++) {
+                uint8_t val   = copies[j]->sectorData.data[i];
+                bool suspect = isSuspect(&copies[j]->sectorData, i);
+                int weight   = 0;
+                for (unsigned k = 0; k < cnt; k++)
+                    if (copies[k]->sectorData.data[i] == val)
+                        weight += isSuspect(&copies[k]->sectorData, i) ? 1 : 2;
+                if (weight > bestWeight || (weight == bestWeight && !suspect)) {
+                    bestWeight = weight;
+                    voted[i] = val | (suspect ? SUSPECT : 0);
+                }
+            }
+        }
+        if (chkData(slot, voted, len)) {
+            for (unsigned i = 0; i < len; i++)
+                voted[i] &= 0xff;               // crc ok so remove suspect markers
+            addSectorData(-slot, true, len, voted);
+            p->status |= SS_VOTED;
+            logFull(ALWAYS, "@slot %d recovered by voting across %d copies\n", slot, cnt);
+            recovered = true;
+        }
+    }
+    return recovered;
+}
+
+/*
+ * last resort for sectors with only bad data, try each copy to see if fixData can correct
+ * a small crc error. If copies correct to different data, none of them is trusted.
+ * Corrected sectors are flagged so they can be reported
+ */
+void correctSectors(int (*fixData)(int slot, uint16_t *data, unsigned len)) {
+    uint16_t fixed[MAXVOTELEN];
+    uint16_t firstFix[MAXVOTELEN];
+
+    assert(trackPtr);
+    for (int slot = 0; slot < trackPtr->fmt->spt; slot++) {
+        sector_t *p = &trackPtr->sectors[slot];
+        if (p->status & SS_DATAGOOD)
+            continue;
+        int bits = 0;
+        unsigned fixLen = 0;
+        bool conflict = false;
+        for (sectorDataList_t *q = p->sectorDataList; q && !conflict; q = q->next) {
+            unsigned len = q->sectorData.len;
+            if (len > MAXVOTELEN)
+                continue;
+            unpackSectorData(&q->sectorData, fixed);
+            int cnt = fixData(slot, fixed, len);
+            if (cnt) {
+                for (unsigned i = 0; i < len; i++)
+                    fixed[i] &= 0xff;
+                if (!bits) {
+                    memcpy(firstFix, fixed, len * sizeof(fixed[0]));
+                    fixLen = len;
+                    bits = cnt;
+                } else if (len != fixLen || memcmp(firstFix, fixed, len * sizeof(fixed[0])) != 0)
+                    conflict = true;
+            }
+        }
+        if (conflict)
+            logFull(ALWAYS, "@slot %d crc corrections disagree, not used\n", slot);
+        else if (bits) {
+            addSectorData(-slot, true, fixLen, firstFix);
+            p->status |= SS_CORRECTED;
+            trackPtr->cntCorrected++;
+            logFull(ALWAYS, "@slot %d crc corrected %d bit%s\n", slot, bits, bits > 1 ? "s" : "");
+        }
+    }
+}
+
 
 
 
@@ -25,14 +25,18 @@
 // PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
 
 #pragma once
+#include <stddef.h>
 #include "formats.h"
 #include "sectorManager.h"
 
 #define MAXCYLINDER 84
+#define MAXCAPTURE  32      // captures of a disk that can be fused
 
 
 // track status flags
-enum {TS_FIXEDID = 1, TS_BADID = 2, TS_CYL = 4, TS_MCYL = 8, TS_SIDE = 16, TS_MSIDE = 32, TS_TOOMANY = 64};
+enum {TS_FIXEDID = 1, TS_BADID = 2, TS_CYL = 4, TS_MCYL = 8, TS_SIDE = 16, TS_MSIDE = 32, TS_TOOMANY = 64,
+      TS_RELEASED = 128,     // released tracks only keep the status, not the sector data
+      TS_SPILLED = 256};     // a copy of the track is in the spill file
 
 
 typedef struct {
@@ -45,6 +49,7 @@ typedef struct {
     int cntGoodIdam;
     int cntGoodData;
     int cntAnyData;
+    int cntCorrected;
     uint8_t slotToSector[MAXSECTOR];
     sector_t sectors[];
 } track_t;
@@ -53,12 +58,24 @@ extern int maxCylinder;
 extern int maxHead;
 
 extern track_t* trackPtr;
+extern int captureId;       // capture being decoded, recorded in each sector
 
 bool checkTrack(int profile);
+void *diskAlloc(size_t size);
+void enforceBudget();
+void correctSectors(int (*fixData)(int slot, uint16_t *data, unsigned len));
 void finaliseTrack();
 track_t* getTrack(int cylinder, int side);
 bool hasTrack(int cylinder, int head);
 void initTrack(int cylinder, int side);
+bool isTrackComplete(int cylinder, int head);
+bool isTrackGood();
+bool isOverBudget();
 void logCylHead(int cylinder, int head);
+void mergeTrack(track_t const *prev);
+void releaseTrack(int cylinder, int head);
 void removeDisk();
+bool restoreTrack(int cylinder, int head);
+void setMemoryBudget(size_t bytes);
 void updateTrackFmt();
+bool voteSectors(bool (*chkData)(int slot, uint16_t *data, unsigned len));
@@ -0,0 +1,124 @@
+/****************************************************************************
+ *  program: flux2imd - create imd image file from kryoflux file            *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+    trcdump - display a binary trace file written by flux2imd -t
+
+    Each bit record shows the bit position, dpll cell width and phase, the 64 half bit
+    pattern and its decode, and for matches the address mark found.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dpll.h"
+#include "formats.h"
+#include "trace.h"
+#include "util.h"
+#include "utility.h"
+
+char const help[] =
+    "usage: %s [-m] [-t cyl[.head]] file.trc\n"
+    "  -m              only show the address marks found\n"
+    "  -t cyl[.head]   only show the given cylinder, and head if specified\n";
+
+static char *encodings[] = { "FM5", "FM5H", "FM8", "FM8H", "MFM5", "MFM5H", "MFM8", "MFM8H", "M2FM8" };
+
+static bool matchesOnly;
+static int selCyl  = -1;
+static int selHead = -1;
+
+static void dumpTrace(FILE *fp) {
+    traceRec_t rec;
+    formatInfo_t fmt = { 0 };
+    bool show        = true;
+
+    selectFormat(&fmt);                 // decode only needs the encoding
+    while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+        switch (rec.type) {
+        case TR_TRACK:
+            show = (selCyl < 0 || selCyl == (int)rec.bitPos) && (selHead < 0 || selHead == rec.cellSize);
+            if (show)
+                printf("Track %02u/%u\n", rec.bitPos, rec.cellSize);
+            break;
+        case TR_BLOCK:
+            fmt.encoding = rec.am < sizeof(encodings) / sizeof(encodings[0]) ? rec.am : E_MFM5;
+            selectFormat(&fmt);
+            if (show)
+                printf("Block %s profile %u nominal cell %uns\n", encodings[fmt.encoding], rec.bitPos,
+                       rec.cellSize);
+            break;
+        case TR_BIT:
+        case TR_MATCH:
+            if (show && (rec.type == TR_MATCH || !matchesOnly)) {
+                pattern   = rec.pattern;
+                bits65_66 = rec.bits65_66;
+                printf("%6u: %5u %2u %s %016llX %s", rec.bitPos, rec.cellSize, rec.phase, bin64Str(pattern),
+                       (unsigned long long)pattern, decodePattern64());
+                if (rec.type == TR_MATCH)
+                    printf(" %s", getName(rec.am));
+                putchar('\n');
+            }
+            break;
+        default:
+            fprintf(stderr, "Corrupt trace record type %d\n", rec.type);
+            return;
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    char magic[8];
+    uint16_t hdr[2];
+    FILE *fp;
+
+    while (getopt(argc, argv, "mt:") != EOF) {
+        switch (optopt) {
+        case 'm':
+            matchesOnly = true;
+            break;
+        case 't':
+            if (sscanf(optarg, "%d.%d", &selCyl, &selHead) < 1 || selCyl < 0)
+                usage("Invalid track '%s' for -t option", optarg);
+            break;
+        default:
+            usage("invalid option -%c", optopt);
+        }
+    }
+    if (optind != argc - 1)
+        usage("Expected a single trace file");
+
+    if ((fp = fopen(argv[optind], "rb")) == NULL)
+        fatal("Cannot open %s", argv[optind]);
+    if (fread(magic, 1, 8, fp) != 8 || memcmp(magic, TRACEMAGIC, 8) != 0 || fread(hdr, sizeof(hdr), 1, fp) != 1 ||
+        hdr[0] != TRACEVERSION || hdr[1] != sizeof(traceRec_t))
+        fatal("%s is not a compatible trace file", argv[optind]);
+    printf("   Bit  Cell Ph Pattern (clock/data half bits)                                 Hex              Decoded\n");
+    dumpTrace(fp);
+    fclose(fp);
+    return 0;
+}
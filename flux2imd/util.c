@@ -23,7 +23,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
+#include <sys/stat.h>
 #include "util.h"
+#ifdef _MSC_VER
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
 #ifdef __GNUC__
 #include <limits.h>
 #define _MAX_PATH PATH_MAX
@@ -32,6 +39,13 @@
 char logPrefix[_MAX_PATH + 3];      // fname[item];
 unsigned debug;
 FILE *logFp = NULL;  
+static bool logFiles = true;
+
+#ifdef _MSC_VER
+#define NULLDEVICE  "NUL"
+#else
+#define NULLDEVICE  "/dev/null"
+#endif
 
 // flip the order of the data
 uint8_t flip[] = {
@@ -70,53 +84,216 @@ const char* basename(const char* fname) {
 }
 
 
+/*
+ * log sink
+ * messages are formatted once into memory and the text for a log file is collected
+ * into chunks, which a writer thread writes to the file in order. A chunk is handed
+ * to the writer when it is full or at the end of each track, so writing the log does
+ * not hold up decoding. Warnings and errors are also written to stderr immediately
+ * and log output to stdout is written directly to keep it in order with other output
+ */
+#define LOGCHUNK    (64 * 1024)
+#define LOGQUEUE    32              // chunks waiting to be written before the decoder waits
+#define LOGLINE     512             // longer messages are allocated
+
+typedef struct {
+    FILE *fp;
+    char *data;
+    size_t len;
+} logChunk_t;
+
+static logChunk_t logQueue[LOGQUEUE];
+static int logHead;
+static int logCount;
+static mtx_t logLock;
+static cnd_t logChanged;            // signalled when a chunk is queued or written
+static thrd_t logWriter;
+static bool logStarted;
+static bool logStopping;
+
+static char *logBuf;                // chunk being filled for logFp
+static size_t logLen;
+
+static int logWriterMain(void *arg) {
+    (void)arg;
+    mtx_lock(&logLock);
+    for (;;) {
+        while (logCount == 0 && !logStopping)
+            cnd_wait(&logChanged, &logLock);
+        if (logCount == 0)
+            break;
+        logChunk_t *chunk = &logQueue[logHead];
+        mtx_unlock(&logLock);
+        fwrite(chunk->data, 1, chunk->len, chunk->fp);
+        free(chunk->data);
+        mtx_lock(&logLock);
+        logHead = (logHead + 1) % LOGQUEUE;
+        logCount--;
+        cnd_broadcast(&logChanged);
+    }
+    mtx_unlock(&logLock);
+    return 0;
+}
+
+// wait for the writer to finish and stop it, the log file itself is left open
+static void logShutdown() {
+    logDrain();
+    if (logStarted) {
+        mtx_lock(&logLock);
+        logStopping = true;
+        cnd_broadcast(&logChanged);
+        mtx_unlock(&logLock);
+        thrd_join(logWriter, NULL);
+        logStarted = logStopping = false;
+    }
+}
+
+static bool logStart() {
+    if (mtx_init(&logLock, mtx_plain) != thrd_success)
+        return false;
+    if (cnd_init(&logChanged) != thrd_success) {
+        mtx_destroy(&logLock);
+        return false;
+    }
+    if (thrd_create(&logWriter, logWriterMain, NULL) != thrd_success) {
+        cnd_destroy(&logChanged);
+        mtx_destroy(&logLock);
+        return false;
+    }
+    atexit(logShutdown);
+    return logStarted = true;
+}
+
+// hand the current chunk to the writer thread, if it cannot be started the chunk is written directly
+static void logQueueChunk() {
+    if (!logLen)
+        return;
+    if (!logStarted && !logStart()) {
+        fwrite(logBuf, 1, logLen, logFp);
+        logLen = 0;
+        return;
+    }
+    mtx_lock(&logLock);
+    while (logCount == LOGQUEUE)
+        cnd_wait(&logChanged, &logLock);
+    logChunk_t *chunk = &logQueue[(logHead + logCount++) % LOGQUEUE];
+    chunk->fp         = logFp;
+    chunk->data       = logBuf;
+    chunk->len        = logLen;
+    cnd_broadcast(&logChanged);
+    mtx_unlock(&logLock);
+    logBuf = NULL;
+    logLen = 0;
+}
+
+// queue the log text for the track just decoded
+void logEndTrack() {
+    logQueueChunk();
+}
+
+// write all of the buffered log text, used before the log file is closed
+void logDrain() {
+    logQueueChunk();
+    if (logStarted) {
+        mtx_lock(&logLock);
+        while (logCount)
+            cnd_wait(&logChanged, &logLock);
+        mtx_unlock(&logLock);
+    }
+    if (logFp)
+        fflush(logFp);
+}
+
+static void logWrite(const char *msg, size_t len) {
+    if (logFp == stdout) {
+        fwrite(msg, 1, len, stdout);
+        return;
+    }
+    if (logBuf && logLen + len > LOGCHUNK)
+        logQueueChunk();
+    if (!logBuf)
+        logBuf = (char *)xmalloc(len > LOGCHUNK ? len : LOGCHUNK);
+    memcpy(logBuf + logLen, msg, len);
+    logLen += len;
+}
+
+// format a message, returning buf or an allocated string if it is too long for buf
+static char *logFormat(char *buf, size_t size, int *len, const char *fmt, va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    int n = vsnprintf(buf, size, fmt, copy);
+    va_end(copy);
+    if (n < 0)
+        n = 0, *buf = '\0';
+    else if ((size_t)n >= size)
+        vsnprintf(buf = (char *)xmalloc(n + 1), n + 1, fmt, args);
+    *len = n;
+    return buf;
+}
+
 int logBasic(char* fmt, ...) {
+    char line[LOGLINE];
+    int len;
     va_list args;
     va_start(args, fmt);
+    char *msg = logFormat(line, sizeof(line), &len, fmt, args);
+    va_end(args);
 
     if ((debug & D_ECHO) && logFp != stdout)
-        vprintf(fmt, args);
-    int nchars = vfprintf(logFp, fmt, args);
-    va_end(args);
-    return nchars;
+        fwrite(msg, 1, len, stdout);
+    logWrite(msg, len);
+    if (msg != line)
+        free(msg);
+    return len;
 }
 
 void logFull(int level, char *fmt, ...) {
     static char* prefix[] = { "WARNING", "ERROR", "FATAL" };
+    char line[LOGLINE];
+    char head[sizeof(logPrefix) + 16];
+    int len;
 
     va_list args;
     va_start(args, fmt);
+    char *msg = logFormat(line, sizeof(line), &len, fmt, args);
+    va_end(args);
 
     if (level >= D_WARNING) {
+        int headLen = sprintf(head, "%s - %s: ", logPrefix, prefix[level - D_WARNING]);
         if (logFp != stdout) {
-            fprintf(logFp, "%s - %s: ", logPrefix, prefix[level - D_WARNING]);
-            vfprintf(logFp, fmt, args);
+            logWrite(head, headLen);
+            logWrite(msg, len);
         }
-        fprintf(stderr, "%s - %s: ", logPrefix, prefix[level - D_WARNING]);
-        vfprintf(stderr, fmt, args);
+        fprintf(stderr, "%s%s", head, msg);
     }
     else if (level ==  0 || (debug & level)) {
-        fprintf(logFp, "%s%s", logPrefix, *fmt ? " - " : ""); // don't use - separator if no string to emit
-        vfprintf(logFp, fmt, args);
-        if ((debug & D_ECHO) && logFp != stdout) {
-            printf("%s%s", logPrefix, *fmt ? " - " : "");
-            vprintf(fmt, args);
-        }
+        int headLen = sprintf(head, "%s%s", logPrefix, *fmt ? " - " : ""); // don't use - separator if no string to emit
+        logWrite(head, headLen);
+        logWrite(msg, len);
+        if ((debug & D_ECHO) && logFp != stdout)
+            printf("%s%s", head, msg);
     }
- 
+    if (msg != line)
+        free(msg);
+
     if (level == D_FATAL) {
+        logDrain();
         if (logFp != stdout)
             fclose(logFp);
+        logFp = stdout;
         exit(1);
     }
-    va_end(args);
 }
 
 void createLogFile(const char* name) {
     char logFile[_MAX_PATH + 1];
+    logDrain();
     if (logFp && logFp != stdout)
         fclose(logFp);
-    if (name) {
+    if (name && !logFiles) {
+        if ((logFp = fopen(NULLDEVICE, "wt")) == NULL)
+            logFp = stdout;
+    } else if (name) {
         strcpy(logFile, name);
         strcpy(strrchr(logFile, '.'), ".log");
         if ((logFp = fopen(logFile, "wt")) == NULL) {
@@ -128,6 +305,11 @@ void createLogFile(const char* name) {
 
 }
 
+// when disabled, the log for a file is discarded, errors and warnings are still shown
+void enableLogFiles(bool enable) {
+    logFiles = enable;
+}
+
 void* xmalloc(size_t size) {
     void* ptr;
     if (!(ptr = malloc(size))) {
@@ -142,4 +324,61 @@ void setLogPrefix(const char *container, const char *element) {
     strcpy(logPrefix, basename(container));
     if (element && *element)
         sprintf(strchr(logPrefix, 0), "[%s]", basename(element));
-}
\ No newline at end of file
+}
+
+bool isDir(const char *name) {
+    struct stat st;
+    return stat(name, &st) == 0 && (st.st_mode & S_IFDIR);
+}
+
+// name of the disk image for a directory of .raw files, the directory name with .imd added
+const char *dirDiskName(const char *dir) {
+    static char name[_MAX_PATH + 5];
+
+    strcpy(name, dir);
+    char *s = strchr(name, '\0');
+    while (s > name + 1 && (s[-1] == '/' || s[-1] == '\\'))
+        *--s = '\0';
+    const char *last = basename(name);
+    if (strcmp(last, ".") == 0 || strcmp(last, "..") == 0) {       // e.g. -m . is named from the real directory
+#ifdef _MSC_VER
+        if (!_fullpath(name, dir, _MAX_PATH))
+#else
+        if (!realpath(dir, name))
+#endif
+            strcpy(name, dir);
+    }
+    return strcat(name, ".imd");
+}
+
+// call onFile with the path of each file in dir, sub directories are ignored
+bool scanDir(const char *dir, void (*onFile)(const char *path)) {
+    char path[_MAX_PATH + 1];
+#ifdef _MSC_VER
+    struct _finddata_t info;
+    intptr_t handle;
+
+    snprintf(path, sizeof(path), "%s/*", dir);
+    if ((handle = _findfirst(path, &info)) == -1)
+        return false;
+    do {
+        snprintf(path, sizeof(path), "%s/%s", dir, info.name);
+        if (!(info.attrib & _A_SUBDIR))
+            onFile(path);
+    } while (_findnext(handle, &info) == 0);
+    _findclose(handle);
+#else
+    DIR *curdir;
+    struct dirent *dentry;
+
+    if (!(curdir = opendir(dir)))
+        return false;
+    while ((dentry = readdir(curdir))) {
+        snprintf(path, sizeof(path), "%s/%s", dir, dentry->d_name);
+        if (!isDir(path))
+            onFile(path);
+    }
+    closedir(curdir);
+#endif
+    return true;
+}
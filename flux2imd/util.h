@@ -62,8 +62,14 @@ void* xmalloc(size_t size);
 extern uint8_t flip[];
 void logFull(int level, char* fmt, ...);
 int logBasic(char* fmt, ...);
+void logEndTrack();
+void logDrain();
 
 bool extMatch(const char* fname, const char* ext);
+bool isDir(const char *name);
+const char *dirDiskName(const char *dir);
+bool scanDir(const char *dir, void (*onFile)(const char *path));
 const char* basename(const char* fname);
 void createLogFile(const char *fname);
+void enableLogFiles(bool enable);
 void setLogPrefix(const char *container, const char *element);
\ No newline at end of file
@@ -0,0 +1,292 @@
+/****************************************************************************
+ *  program: flux2imd - create imd image file from kryoflux file            *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+    watch mode
+    decodes the .raw files written to a directory by a capture station as each one is completed,
+    so the decode overlaps the capture.
+    On Linux inotify reports the files as they are closed, elsewhere the directory is polled
+    and a file is taken as complete once its size and modified time are unchanged between polls.
+    An interrupt, e.g. Ctrl-C, ends the watch cleanly so the caller can write its files
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include "util.h"
+#include "watch.h"
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#ifndef F_SETLEASE
+#define F_SETLEASE  1024    // linux specific, only declared with _GNU_SOURCE which clashes with basename
+#endif
+#else
+#ifdef _MSC_VER
+#include <windows.h>
+#define sleep(n)    Sleep((n) * 1000)
+#else
+#include <unistd.h>
+#endif
+#endif
+
+#ifdef __GNUC__
+#include <limits.h>
+#define _MAX_PATH PATH_MAX
+#endif
+
+static bool (*trackHandler)(const char *path);
+static volatile sig_atomic_t interrupted;
+
+static void onInterrupt(int sig) {
+    (void)sig;
+    interrupted = 1;
+}
+
+#ifndef __linux__
+typedef struct {
+    char *path;
+    time_t mtime;
+    long size;
+    bool seen;              // found on the current poll
+    bool done;              // decoded since last change
+} file_t;
+
+static file_t *files;
+static unsigned cntFiles;
+static unsigned sizeFiles;
+static bool anyDecoded;
+
+static void pollFile(const char *path) {
+    struct stat st;
+    unsigned i;
+
+    if (!extMatch(path, ".raw") || stat(path, &st) != 0)
+        return;
+    for (i = 0; i < cntFiles && strcmp(files[i].path, path) != 0; i++)
+        ;
+    if (i == cntFiles) {
+        if (cntFiles == sizeFiles) {
+            file_t *newFiles = (file_t *)xmalloc((sizeFiles += 64) * sizeof(file_t));
+            if (files) {
+                memcpy(newFiles, files, cntFiles * sizeof(file_t));
+                free(files);
+            }
+            files = newFiles;
+        }
+        files[cntFiles].path  = strcpy((char *)xmalloc(strlen(path) + 1), path);
+        files[cntFiles].mtime = st.st_mtime;
+        files[cntFiles].size  = (long)st.st_size;
+        files[cntFiles].done  = false;
+        cntFiles++;
+    } else if (files[i].mtime != st.st_mtime || files[i].size != (long)st.st_size) {
+        files[i].mtime = st.st_mtime;           // still changing
+        files[i].size  = (long)st.st_size;
+        files[i].done  = false;
+    } else if (!files[i].done) {
+        files[i].done = true;
+        anyDecoded = true;
+        trackHandler(path);
+    }
+}
+
+bool watchDir(const char *dir, unsigned idleSecs, bool (*onTrack)(const char *path), bool (*onIdle)()) {
+    time_t lastTrack = time(NULL);
+    bool ok          = true;
+
+    trackHandler = onTrack;
+    interrupted  = 0;
+    void (*prevHandler)(int) = signal(SIGINT, onInterrupt);
+    while (!interrupted) {
+        anyDecoded = false;
+        if (!scanDir(dir, pollFile)) {
+            ok = false;
+            break;
+        }
+        if (anyDecoded)
+            lastTrack = time(NULL);
+        else if (time(NULL) - lastTrack >= (time_t)idleSecs) {
+            if (onIdle())
+                break;
+            lastTrack = time(NULL);
+        }
+        sleep(1);
+    }
+    signal(SIGINT, prevHandler);
+    return ok;
+}
+
+#else
+
+/*
+    files already in the directory may still be being written. A read lease cannot be taken
+    on a file open for writing, so these are left for their close event. If the lease test
+    is not possible, e.g. the file is owned by another user, the file is held as pending and
+    decoded once its size and modified time are unchanged for WATCHSETTLE seconds, unless
+    a close event for it arrives first
+*/
+#define WATCHSETTLE 2
+
+typedef struct {
+    char *path;
+    time_t mtime;
+    long size;
+} pending_t;
+
+static pending_t *pending;
+static unsigned cntPending;
+static unsigned sizePending;
+
+enum { W_CLOSED, W_WRITING, W_UNKNOWN };
+
+static int writeState(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return W_UNKNOWN;
+    int state = W_CLOSED;
+    if (fcntl(fd, F_SETLEASE, F_RDLCK) < 0)
+        state = errno == EAGAIN ? W_WRITING : W_UNKNOWN;
+    else
+        fcntl(fd, F_SETLEASE, F_UNLCK);
+    close(fd);
+    return state;
+}
+
+static void addExisting(const char *path) {
+    struct stat st;
+
+    if (!extMatch(path, ".raw") || stat(path, &st) != 0)
+        return;
+    int state = writeState(path);
+    if (state == W_CLOSED)
+        trackHandler(path);
+    if (state != W_UNKNOWN)
+        return;
+    if (cntPending == sizePending) {
+        pending_t *newPending = (pending_t *)xmalloc((sizePending += 64) * sizeof(pending_t));
+        if (pending) {
+            memcpy(newPending, pending, cntPending * sizeof(pending_t));
+            free(pending);
+        }
+        pending = newPending;
+    }
+    pending[cntPending].path  = strcpy((char *)xmalloc(strlen(path) + 1), path);
+    pending[cntPending].mtime = st.st_mtime;
+    pending[cntPending].size  = (long)st.st_size;
+    cntPending++;
+}
+
+static void dropPending(unsigned i) {
+    free(pending[i].path);
+    pending[i] = pending[--cntPending];
+}
+
+// a close event for a pending file means it is complete and is decoded from the event
+static void closedPending(const char *path) {
+    for (unsigned i = 0; i < cntPending; i++)
+        if (strcmp(pending[i].path, path) == 0) {
+            dropPending(i);
+            return;
+        }
+}
+
+// decode the pending files that have not changed since last checked
+static void settlePending() {
+    struct stat st;
+
+    for (unsigned i = 0; i < cntPending;) {
+        if (stat(pending[i].path, &st) != 0)
+            dropPending(i);
+        else if (pending[i].mtime != st.st_mtime || pending[i].size != (long)st.st_size) {
+            pending[i].mtime = st.st_mtime;       // still being written
+            pending[i].size  = (long)st.st_size;
+            i++;
+        } else {
+            trackHandler(pending[i].path);
+            dropPending(i);
+        }
+    }
+}
+
+bool watchDir(const char *dir, unsigned idleSecs, bool (*onTrack)(const char *path), bool (*onIdle)()) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    char path[_MAX_PATH + 1];
+    struct pollfd pfd;
+
+    trackHandler = onTrack;
+    if ((pfd.fd = inotify_init()) < 0 || inotify_add_watch(pfd.fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        logFull(D_ERROR, "cannot watch %s\n", dir);
+        return false;
+    }
+    pfd.events  = POLLIN;
+    interrupted = 0;
+    void (*prevHandler)(int) = signal(SIGINT, onInterrupt);
+    scanDir(dir, addExisting);      // any already captured, events for those still being written follow
+    time_t settleTime = time(NULL) + WATCHSETTLE;
+
+    while (!interrupted) {
+        bool settling = cntPending != 0;
+        int ready = poll(&pfd, 1, (settling ? WATCHSETTLE : (int)idleSecs) * 1000);
+        if (ready < 0) {
+            if (errno == EINTR)
+                continue;           // the loop ends if it was an interrupt
+            break;
+        }
+        if (settling && time(NULL) >= settleTime) {
+            settlePending();
+            settleTime = time(NULL) + WATCHSETTLE;
+        }
+        if (ready == 0) {
+            if (!settling && onIdle())
+                break;
+            continue;
+        }
+        ssize_t len = read(pfd.fd, buf, sizeof(buf));
+        if (len < 0 && errno == EINTR)
+            continue;
+        if (len <= 0)
+            break;
+        for (char *p = buf; p < buf + len; p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len) {
+            struct inotify_event *event = (struct inotify_event *)p;
+            if (event->len && !(event->mask & IN_ISDIR) && extMatch(event->name, ".raw")) {
+                snprintf(path, sizeof(path), "%s/%s", dir, event->name);
+                closedPending(path);
+                onTrack(path);
+            }
+        }
+    }
+    signal(SIGINT, prevHandler);
+    close(pfd.fd);
+    return true;
+}
+#endif
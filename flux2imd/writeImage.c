@@ -44,6 +44,12 @@ MODIFICATION HISTORY
 #include "flux2imd.h"
 #include "trackManager.h"
 #include "util.h"
+#ifdef _MSC_VER
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
 #ifdef __GNUC__
 #include <limits.h>
 #define _MAX_PATH PATH_MAX
@@ -57,15 +63,6 @@ static bool SameCh(uint8_t *pData, int size) {      // valid sectors have the SU
     return true;
 }
 
-static uint8_t *sectorToUint8(track_t* trackPtr, uint8_t slot) {
-    static uint8_t sectorBytes[1024];
-    uint16_t* sectorRawData = trackPtr->sectors[slot].sectorDataList->sectorData.rawData;
-
-    for (int i = 0; i < 128 << trackPtr->fmt->sSize; i++)
-        sectorBytes[i] = (uint8_t)sectorRawData[i];
-    return sectorBytes;
-}
-
 static void WriteIMDHdr(FILE* fp, const char* fname) {
     struct tm* dateTime;
     time_t curTime;
@@ -80,9 +77,60 @@ static void WriteIMDHdr(FILE* fp, const char* fname) {
 // E_FM5, E_FM5H, E_FM8, E_FM8H, E_MFM5, E_MFM5H, E_MFM8, E_MFM8H, E_M2FM8
 static uint8_t imdModes[] = { 2, 2, 0, 0, 5, 5, 3, 3, 3 };
 
+static void writeImdTrack(FILE *fp, int cyl, int head) {
+    track_t *trackPtr = getTrack(cyl, head);
+
+    putc(imdModes[trackPtr->fmt->encoding], fp);           // mode
+    putc(cyl, fp);                      // cylinder
+    putc(head | ((trackPtr->status & TS_CYL) ? 0x80 : 0) | ((trackPtr->status & TS_SIDE) ? 0x40 : 0), fp);                     // head
+    putc(trackPtr->fmt->spt, fp);       // sectors in track
+    putc(trackPtr->fmt->sSize, fp);     // sector size
+    fwrite(trackPtr->slotToSector, 1, trackPtr->fmt->spt, fp);    // sector numbering map
+    if (trackPtr->status & TS_CYL) {
+        logFull(D_WARNING, "cylinder map needed for track %02d/%d\n", trackPtr->cylinder, trackPtr->side);
+        for (int i = 0; i < trackPtr->fmt->spt; i++)
+            if (trackPtr->sectors[i].status & SS_IDAMGOOD)
+                putc(trackPtr->sectors[i].idam.cylinder, fp);
+            else
+                putc(trackPtr->altCylinder, fp);
+    }
+    if (trackPtr->status & TS_SIDE) {
+        logFull(D_WARNING, "head map needed for track %02d/%d\n", trackPtr->cylinder, trackPtr->side);
+        for (int i = 0; i < trackPtr->fmt->spt; i++)
+            putc(trackPtr->sectors[i].idam.side, fp);
+    }
+
+    for (int slot = 0; slot < trackPtr->fmt->spt; slot++) {
+        if (trackPtr->sectors[slot].status & SS_DATAGOOD) {
+            uint8_t *pSec = trackPtr->sectors[slot].sectorDataList->sectorData.data;
+            if (SameCh(pSec, 128 << trackPtr->fmt->sSize)) {
+                putc(2, fp);
+                putc(pSec[0], fp);
+            } else {
+                putc(1, fp);
+                fwrite(pSec, 1, 128 << trackPtr->fmt->sSize, fp);
+            }
+        } else
+            putc(0, fp);            // data not available
+    }
+}
+
+/*
+ * returns true if the track is to be written, reading it back first if it was spilled.
+ * restored is set if this was done so the caller can release it again
+ */
+static bool loadImdTrack(int cyl, int head, bool *restored) {
+    track_t *trackPtr = getTrack(cyl, head);
+    *restored = false;
+    if (!trackPtr || (trackPtr->status & TS_BADID) || !hasTrack(cyl, head))
+        return false;
+    if (trackPtr->status & TS_RELEASED)
+        *restored = restoreTrack(cyl, head);    // only spilled tracks can be read back
+    return *restored || !(trackPtr->status & TS_RELEASED);
+}
+
 void writeImdFile(const char *fname) {
     FILE *fp;
-    track_t *trackPtr;
     char imdFile[_MAX_PATH + 1];
 
 
@@ -101,45 +149,96 @@ void writeImdFile(const char *fname) {
     WriteIMDHdr(fp, fname);
     for (int cyl = 0; cyl <= maxCylinder; cyl++)
         for (int head = 0; head <= maxHead; head++) {
-            trackPtr = getTrack(cyl, head);
-            if (!trackPtr || trackPtr->status & TS_BADID || !hasTrack(cyl, head))
-                continue;
-            putc(imdModes[trackPtr->fmt->encoding], fp);           // mode
-            putc(cyl, fp);                      // cylinder
-            putc(head | ((trackPtr->status & TS_CYL) ? 0x80 : 0) | ((trackPtr->status & TS_SIDE) ? 0x40 : 0), fp);                     // head
-            putc(trackPtr->fmt->spt, fp);       // sectors in track
-            putc(trackPtr->fmt->sSize, fp);     // sector size
-            fwrite(trackPtr->slotToSector, 1, trackPtr->fmt->spt, fp);    // sector numbering map
-            if (trackPtr->status & TS_CYL) {
-                logFull(D_WARNING, "cylinder map needed for track %02d/%d\n", trackPtr->cylinder, trackPtr->side);
-                for (int i = 0; i < trackPtr->fmt->spt; i++)
-                    if (trackPtr->sectors[i].status & SS_IDAMGOOD)
-                        putc(trackPtr->sectors[i].idam.cylinder, fp);
-                    else
-                        putc(trackPtr->altCylinder, fp);
-            }
-            if (trackPtr->status & TS_SIDE) {
-                logFull(D_WARNING, "head map needed for track %02d/%d\n", trackPtr->cylinder, trackPtr->side);
-                for (int i = 0; i < trackPtr->fmt->spt; i++)
-                    putc(trackPtr->sectors[i].idam.side, fp);
-            }
+            bool restored;
+            if (loadImdTrack(cyl, head, &restored))
+                writeImdTrack(fp, cyl, head);
+            if (restored)
+                releaseTrack(cyl, head);
+        }
+
+    fclose(fp);
+}
 
-            for (int slot = 0; slot < trackPtr->fmt->spt; slot++) {
-                if (trackPtr->sectors[slot].status & SS_DATAGOOD) {
-                    uint8_t *pSec = sectorToUint8(trackPtr, slot);
-                    if (SameCh(pSec, 128 << trackPtr->fmt->sSize)) {
-                        putc(2, fp);
-                        putc(pSec[0], fp);
-                    } else {
-                        putc(1, fp);
-                        fwrite(pSec, 1, 128 << trackPtr->fmt->sSize, fp);
-                    }
-                } else
-                    putc(0, fp);            // data not available
-                
+/*
+ * streaming writer, used when decoding a container
+ * tracks are written in cylinder / head order as soon as all the tracks before them are
+ * known to be complete, after which their sector data is released. isPending reports
+ * whether the container still has data to load for a track, so tracks that arrive out of
+ * order are held until the gap is filled; NULL treats all tracks as complete. The file is
+ * only created once there is a track to write, so failed decodes do not leave an empty file
+ */
+static FILE *streamFp;
+static char streamFile[_MAX_PATH + 1];
+static const char *streamSource;
+static int streamCyl, streamHead;       // the next track to consider writing
+static FILE *imdStdout;                 // the original stdout when the IMD data is written to it
+
+// keep stdout for the IMD data and send anything else written to stdout to stderr
+void setImdStdout() {
+    fflush(stdout);
+#ifdef _MSC_VER
+    int fd = _dup(_fileno(stdout));
+    _setmode(fd, _O_BINARY);
+    imdStdout = _fdopen(fd, "wb");
+    _dup2(_fileno(stderr), _fileno(stdout));
+#else
+    imdStdout = fdopen(dup(fileno(stdout)), "wb");
+    dup2(fileno(stderr), fileno(stdout));
+#endif
+}
+
+void openImdStream(const char *fname) {
+    streamSource   = fname;
+    streamFp       = NULL;
+    streamCyl = streamHead = 0;
+    strcpy(streamFile, fname);
+    strcpy(strrchr(streamFile, '.'), ".imd");
+}
 
+void flushImdStream(bool (*isPending)(int cyl, int head)) {
+    if (!streamSource)
+        return;
+    for (; streamCyl < MAXCYLINDER; streamCyl++, streamHead = 0) {
+        for (; streamHead < 2; streamHead++) {
+            if (isPending && isPending(streamCyl, streamHead))
+                return;
+            bool restored;
+            if (!loadImdTrack(streamCyl, streamHead, &restored))
+                continue;
+            if (!streamFp) {
+                if (imdStdout)
+                    streamFp = imdStdout;
+                else if ((streamFp = fopen(streamFile, "wb")) == NULL) {
+                    logFull(D_ERROR, "cannot create %s\n", basename(streamFile));
+                    streamSource = NULL;
+                    return;
+                }
+                WriteIMDHdr(streamFp, streamSource);
             }
+            writeImdTrack(streamFp, streamCyl, streamHead);
+            releaseTrack(streamCyl, streamHead);
         }
+    }
+}
 
-    fclose(fp);
-}
\ No newline at end of file
+// writes any remaining tracks, discard is used if the disk turns out to be one
+// that cannot be written as an IMD file
+void closeImdStream(bool discard) {
+    if (!discard)
+        flushImdStream(NULL);
+    if (streamFp && streamFp == imdStdout) {
+        fflush(imdStdout);
+        if (discard)
+            logFull(D_WARNING, "Disk cannot be written as an IMD file, output to stdout is incomplete\n");
+        else
+            logFull(ALWAYS, "IMD file written to stdout\n");
+    } else if (streamFp) {
+        fclose(streamFp);
+        if (discard)
+            remove(streamFile);
+        else
+            logFull(ALWAYS, "IMD file %s created\n", basename(streamFile));
+    }
+    streamFp     = NULL;
+    streamSource = NULL;
+}